@@ -1,27 +1,222 @@
-#include <bitset>
+#include <cstddef>
+#include <cstdint>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OB_X86_KERNELS 1
+#endif
+
+/*
+ * Set of bytes stored directly as the lookup tables of the nibble (PSHUFB) membership test.
+ * Byte c with nibbles hi:lo is bit (hi & 7) of rows[hi >> 3][lo], so one shuffle by the low
+ * nibbles fetches the row of every byte and one shuffle by the high nibbles fetches its bit.
+ * All updates are constexpr, sets can be built from string literals at compile time.
+ */
 struct OB
 {
-    using internal_set = std::bitset<256>;
-    OB() = default;
-    OB(const internal_set& set_) : set{set_}{}
-    internal_set set{};
+    uint8_t rows[ 2 ][ 16 ] = {};
+
+    constexpr OB() = default;
+    constexpr explicit OB( const char *chars ) {
+        for ( ; *chars; ++chars )
+            insert( *chars );
+    }
 
-    void insert( char c ) {
-        set.set(c);
+    constexpr void insert( char c ) {
+        row( c ) |= bit( c );
     }
-    void erase( char c ) {
-        set.reset(c);
+    constexpr void erase( char c ) {
+        row( c ) &= ~bit( c );
     }
-    int count( char c ) {
-        return set[c];
+    constexpr int count( char c ) const {
+        return ( rows[ byte( c ) >> 7 ][ byte( c ) & 0x0f ] & bit( c ) ) != 0;
     }
 
-    OB operator&( const OB &o ) {
-        return set & o.set;
+    constexpr OB operator&( const OB &o ) const {
+        OB result;
+        for ( int i = 0; i < 16; ++i ) {
+            result.rows[ 0 ][ i ] = rows[ 0 ][ i ] & o.rows[ 0 ][ i ];
+            result.rows[ 1 ][ i ] = rows[ 1 ][ i ] & o.rows[ 1 ][ i ];
+        }
+        return result;
+    }
+    constexpr OB operator|( const OB &o ) const {
+        OB result;
+        for ( int i = 0; i < 16; ++i ) {
+            result.rows[ 0 ][ i ] = rows[ 0 ][ i ] | o.rows[ 0 ][ i ];
+            result.rows[ 1 ][ i ] = rows[ 1 ][ i ] | o.rows[ 1 ][ i ];
+        }
+        return result;
+    }
+
+    /* First byte of data[0, size) in the set, data + size if there is none. */
+    const char *find_first_of( const char *data, std::size_t size ) const;
+    /* Length of the longest prefix of data made of bytes in the set (strspn). */
+    std::size_t span( const char *data, std::size_t size ) const;
+    /* Length of the longest prefix of data made of bytes not in the set (strcspn). */
+    std::size_t cspan( const char *data, std::size_t size ) const {
+        return find_first_of( data, size ) - data;
+    }
+    /* Number of bytes of data in the set. */
+    std::size_t count_in( const char *data, std::size_t size ) const;
 
+private:
+    static constexpr uint8_t byte( char c ) {
+        return static_cast< uint8_t >( c );
     }
-    OB operator|( const OB &o ) {
-        return set | o.set;
+    static constexpr uint8_t bit( char c ) {
+        return static_cast< uint8_t >( 1 << ( ( byte( c ) >> 4 ) & 7 ) );
+    }
+    constexpr uint8_t &row( char c ) {
+        return rows[ byte( c ) >> 7 ][ byte( c ) & 0x0f ];
     }
 };
+
+namespace ob_detail {
+
+enum class Simd { Scalar, SSSE3, AVX2 };
+
+inline Simd detect_simd() {
+#ifdef OB_X86_KERNELS
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" ) )
+        return Simd::AVX2;
+    if ( __builtin_cpu_supports( "ssse3" ) )
+        return Simd::SSSE3;
+#endif
+    return Simd::Scalar;
+}
+
+/* Kernels used by all scans, tests lower it to check the other variants. */
+inline Simd &active_simd() {
+    static Simd level = detect_simd();
+    return level;
+}
+
+/* What the vector kernels do with the per-block masks of matching bytes. */
+enum class Scan { First, FirstNot, Count };
+
+#ifdef OB_X86_KERNELS
+/* Bytes of data which are in the set are 0xff, the others 0. */
+__attribute__(( target( "ssse3" ) ))
+inline __m128i match_ssse3( __m128i data, __m128i rows_lo, __m128i rows_hi ) {
+    const __m128i nibble = _mm_set1_epi8( 0x0f );
+    const __m128i bits = _mm_setr_epi8( 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128 );
+    __m128i lo = _mm_and_si128( data, nibble );
+    __m128i hi = _mm_and_si128( _mm_srli_epi16( data, 4 ), nibble );
+    /* bytes >= 0x80 take their row from the second table */
+    __m128i upper = _mm_cmplt_epi8( data, _mm_setzero_si128() );
+    __m128i row = _mm_or_si128( _mm_andnot_si128( upper, _mm_shuffle_epi8( rows_lo, lo ) ),
+                                _mm_and_si128( upper, _mm_shuffle_epi8( rows_hi, lo ) ) );
+    __m128i hit = _mm_and_si128( row, _mm_shuffle_epi8( bits, hi ) );
+    return _mm_xor_si128( _mm_cmpeq_epi8( hit, _mm_setzero_si128() ), _mm_set1_epi8( -1 ) );
+}
+
+__attribute__(( target( "avx2" ) ))
+inline __m256i match_avx2( __m256i data, __m256i rows_lo, __m256i rows_hi ) {
+    const __m256i nibble = _mm256_set1_epi8( 0x0f );
+    const __m256i bits = _mm256_setr_epi8( 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                           1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128 );
+    __m256i lo = _mm256_and_si256( data, nibble );
+    __m256i hi = _mm256_and_si256( _mm256_srli_epi16( data, 4 ), nibble );
+    __m256i row = _mm256_blendv_epi8( _mm256_shuffle_epi8( rows_lo, lo ), _mm256_shuffle_epi8( rows_hi, lo ), data );
+    __m256i hit = _mm256_and_si256( row, _mm256_shuffle_epi8( bits, hi ) );
+    return _mm256_xor_si256( _mm256_cmpeq_epi8( hit, _mm256_setzero_si256() ), _mm256_set1_epi8( -1 ) );
+}
+
+/* Returns index of the first byte found (or size) for First and FirstNot, number of matches for Count.
+ * Only whole blocks are processed, *done says how many bytes were. */
+__attribute__(( target( "ssse3" ) ))
+inline std::size_t scan_ssse3( const OB &set, const char *data, std::size_t size, Scan mode, std::size_t *done ) {
+    __m128i rows_lo = _mm_loadu_si128( reinterpret_cast< const __m128i * >( set.rows[ 0 ] ) );
+    __m128i rows_hi = _mm_loadu_si128( reinterpret_cast< const __m128i * >( set.rows[ 1 ] ) );
+    std::size_t i = 0, counted = 0;
+    for ( ; i + 16 <= size; i += 16 ) {
+        __m128i block = _mm_loadu_si128( reinterpret_cast< const __m128i * >( data + i ) );
+        unsigned mask = _mm_movemask_epi8( match_ssse3( block, rows_lo, rows_hi ) );
+        if ( mode == Scan::Count )
+            counted += __builtin_popcount( mask );
+        else {
+            if ( mode == Scan::FirstNot )
+                mask ^= 0xffff;
+            if ( mask ) {
+                *done = i;
+                return i + __builtin_ctz( mask );
+            }
+        }
+    }
+    *done = i;
+    return mode == Scan::Count ? counted : size;
+}
+
+__attribute__(( target( "avx2" ) ))
+inline std::size_t scan_avx2( const OB &set, const char *data, std::size_t size, Scan mode, std::size_t *done ) {
+    __m256i rows_lo = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i * >( set.rows[ 0 ] ) ) );
+    __m256i rows_hi = _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i * >( set.rows[ 1 ] ) ) );
+    std::size_t i = 0;
+    if ( mode == Scan::Count ) {
+        /* matches are 0xff = -1, subtracting them counts per byte lane; lanes are folded by SAD
+         * every 255 blocks, before a lane can overflow */
+        __m256i total = _mm256_setzero_si256();
+        while ( i + 32 <= size ) {
+            __m256i lanes = _mm256_setzero_si256();
+            for ( int blocks = 0; blocks < 255 && i + 32 <= size; ++blocks, i += 32 ) {
+                __m256i block = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( data + i ) );
+                lanes = _mm256_sub_epi8( lanes, match_avx2( block, rows_lo, rows_hi ) );
+            }
+            total = _mm256_add_epi64( total, _mm256_sad_epu8( lanes, _mm256_setzero_si256() ) );
+        }
+        *done = i;
+        return _mm256_extract_epi64( total, 0 ) + _mm256_extract_epi64( total, 1 ) +
+               _mm256_extract_epi64( total, 2 ) + _mm256_extract_epi64( total, 3 );
+    }
+    for ( ; i + 32 <= size; i += 32 ) {
+        __m256i block = _mm256_loadu_si256( reinterpret_cast< const __m256i * >( data + i ) );
+        unsigned mask = _mm256_movemask_epi8( match_avx2( block, rows_lo, rows_hi ) );
+        if ( mode == Scan::FirstNot )
+            mask = ~mask;
+        if ( mask ) {
+            *done = i;
+            return i + __builtin_ctz( mask );
+        }
+    }
+    *done = i;
+    return size;
+}
+#endif
+
+inline std::size_t scan( const OB &set, const char *data, std::size_t size, Scan mode ) {
+    std::size_t done = 0, result = mode == Scan::Count ? 0 : size;
+    switch ( active_simd() ) {
+#ifdef OB_X86_KERNELS
+        case Simd::AVX2: result = scan_avx2( set, data, size, mode, &done ); break;
+        case Simd::SSSE3: result = scan_ssse3( set, data, size, mode, &done ); break;
+#endif
+        default: break;
+    }
+    if ( mode != Scan::Count && result != size )
+        return result;
+    /* tail shorter than a block, or everything without vector kernels */
+    for ( std::size_t i = done; i < size; ++i ) {
+        bool in = set.count( data[ i ] );
+        if ( mode == Scan::Count )
+            result += in;
+        else if ( in == ( mode == Scan::First ) )
+            return i;
+    }
+    return result;
+}
+
+}
+
+inline const char *OB::find_first_of( const char *data, std::size_t size ) const {
+    return data + ob_detail::scan( *this, data, size, ob_detail::Scan::First );
+}
+
+inline std::size_t OB::span( const char *data, std::size_t size ) const {
+    return ob_detail::scan( *this, data, size, ob_detail::Scan::FirstNot );
+}
+
+inline std::size_t OB::count_in( const char *data, std::size_t size ) const {
+    return ob_detail::scan( *this, data, size, ob_detail::Scan::Count );
+}
@@ -2,16 +2,26 @@
 #define BRICK_BENCHMARK_REG
 #include <brick-benchmark>
 #include "OB.hpp"
+#include <cstdlib>
+#include <string>
 
 using namespace brick::benchmark;
 
 template< typename T >
 struct BenchCharSet : Group
 {
+    std::string text;
+
     BenchCharSet()
     {
         x.type = Axis::Disabled;
         y.type = Axis::Benchmarks;
+        /* 64 KiB of words of 1 to 12 letters separated by single spaces */
+        for ( unsigned i = 0; text.size() < 65536; ++i )
+        {
+            text.append( i * 7 % 12 + 1, 'a' + i % 26 );
+            text += ' ';
+        }
     }
 
     std::string describe()
@@ -50,6 +60,32 @@ struct BenchCharSet : Group
         }
     }
 
+    BENCHMARK( tokenize )
+    {
+        T space;
+        space.insert( ' ' );
+        const char *data = text.data(), *end = data + text.size();
+        int words = 0;
+        while ( data < end )
+        {
+            data += space.span( data, end - data );
+            std::size_t word = space.cspan( data, end - data );
+            words += word > 0;
+            data += word;
+        }
+        if ( words == 0 )
+            std::abort();
+    }
+
+    BENCHMARK( count_in )
+    {
+        T vowels;
+        for ( char c : { 'a', 'e', 'i', 'o', 'u' } )
+            vowels.insert( c );
+        if ( vowels.count_in( text.data(), text.size() ) == 0 )
+            std::abort();
+    }
+
     BENCHMARK( sum )
     {
         insert();
@@ -2,6 +2,7 @@
 #define BRICK_UNITTEST_REG
 #include <brick-unittest>
 #include "OB.hpp"
+#include <string>
 
 template< typename T >
 struct TestCharSet
@@ -56,3 +57,81 @@ struct TestCharSet
 };
 
 template struct TestCharSet< OB >;
+
+struct TestCharSetScan
+{
+    /* every kernel available on this CPU has to agree with the plain loops */
+    template< typename F >
+    static void for_each_simd( F f )
+    {
+        using ob_detail::Simd;
+        Simd &active = ob_detail::active_simd();
+        const Simd detected = active;
+        for ( Simd s : { Simd::Scalar, Simd::SSSE3, Simd::AVX2 } )
+        {
+            if ( s > detected )
+                break;
+            active = s;
+            f();
+        }
+        active = detected;
+    }
+
+    TEST( constexpr_ )
+    {
+        constexpr OB digits( "0123456789" );
+        static_assert( digits.count( '5' ), "constexpr construction" );
+        static_assert( !digits.count( 'a' ), "constexpr construction" );
+        constexpr OB both = digits | OB( "abc" );
+        static_assert( both.count( 'b' ) && both.count( '0' ), "constexpr union" );
+        static_assert( !( digits & OB( "abc" ) ).count( '0' ), "constexpr intersection" );
+    }
+
+    TEST( high_bytes )
+    {
+        OB x;
+        x.insert( '\x80' );
+        x.insert( '\xff' );
+        ASSERT( x.count( '\x80' ) );
+        ASSERT( x.count( '\xff' ) );
+        ASSERT( !x.count( '\x00' ) );
+        ASSERT( !x.count( '\x7f' ) );
+        x.erase( '\xff' );
+        ASSERT( !x.count( '\xff' ) );
+    }
+
+    TEST( scan )
+    {
+        const OB sets[] = { OB(), OB( " \t\n" ), OB( "abcdefghijklmnopqrstuvwxyz_" ), OB( "\x80\x91\xfe\x01" ) };
+        std::string text;
+        unsigned seed = 1;
+        for ( int i = 0; i < 3000; ++i )
+        {
+            seed = seed * 1103515245 + 12345;
+            /* long runs of one class, so both span and cspan reach past whole blocks */
+            int run = ( seed >> 16 ) % 70;
+            char c = static_cast< char >( seed >> 8 );
+            text.append( run, c );
+        }
+
+        for_each_simd( [&] {
+            for ( const OB &set : sets )
+                for ( std::size_t offset = 0; offset < text.size(); offset += 997 )
+                {
+                    const char *data = text.data() + offset;
+                    std::size_t size = text.size() - offset;
+                    std::size_t first = 0, in = 0, count = 0;
+                    while ( first < size && !set.count( data[ first ] ) )
+                        ++first;
+                    while ( in < size && set.count( data[ in ] ) )
+                        ++in;
+                    for ( std::size_t i = 0; i < size; ++i )
+                        count += set.count( data[ i ] );
+                    ASSERT_EQ( set.find_first_of( data, size ) - data, first );
+                    ASSERT_EQ( set.cspan( data, size ), first );
+                    ASSERT_EQ( set.span( data, size ), in );
+                    ASSERT_EQ( set.count_in( data, size ), count );
+                }
+        } );
+    }
+};
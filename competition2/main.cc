@@ -1,36 +1,176 @@
+#include "prime_count.hh"
+#include "prime_index.hh"
+#include "sieve.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 #include <iostream>
-#include <vector>
-#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
 
-int main(int argc, char* argv[]) {
-    int nth_prime = std::atoi(argv[1]);
+/// Queries read from stdin are answered together, in batches of this many
+constexpr std::size_t batch_size = 1 << 20;
 
-    std::vector<bool> array;
+/// Parses whole token as n of an nth prime query, which has to be from 1 to nth_prime_max
+bool parse_query(std::string_view token, uint64_t& query){
+    auto last = token.data() + token.size();
+    auto [end, error] = std::from_chars(token.data(), last, query);
+    return error == std::errc{} && end == last && query >= 1 && query <= nth_prime_max;
+}
 
-    array.resize(static_cast<unsigned long>(nth_prime * std::log(nth_prime) + nth_prime * std::log(std::log(nth_prime))), false);
+/// Splits stdin into whitespace separated tokens line by line, so errors can tell the line of a token
+class token_reader {
+public:
+    /// Next token, valid until the next call, returns false at end of input
+    bool next(std::string_view& token){
+        for(;;){
+            while(m_position < m_line.size() && std::isspace(static_cast<unsigned char>(m_line[m_position]))){
+                ++m_position;
+            }
+            if(m_position < m_line.size()){
+                break;
+            }
+            if(!std::getline(std::cin, m_line)){
+                return false;
+            }
+            ++m_line_number;
+            m_position = 0;
+        }
+        auto start = m_position;
+        while(m_position < m_line.size() && !std::isspace(static_cast<unsigned char>(m_line[m_position]))){
+            ++m_position;
+        }
+        token = std::string_view{m_line}.substr(start, m_position - start);
+        return true;
+    }
 
-    int current = 2;
-    int primes_found = 0;
+    /// Line of the last token, counting from one
+    uint64_t line_number() const {
+        return m_line_number;
+    }
+
+private:
+    std::string m_line;
+    std::size_t m_position = 0;
+    uint64_t m_line_number = 0;
+};
 
-    while(true){
-        if(array[current] == true){
-            current++;
-            continue;
+/// Answers queries from stdin, one nth prime per line in order of queries
+/// Index file is used when it covers the whole batch, otherwise batch is sieved and the index is replaced
+/// after its answers are printed, a failure to store the index is only a warning
+/// Reading stops at the first token which isn't a valid query, queries before it are still answered,
+/// then the token is reported and 1 is returned
+int answer_batches(const char* index_path){
+    std::unique_ptr<prime_index> index;
+    if(index_path){
+        try{
+            index = std::make_unique<prime_index>(index_path);
         }
-        primes_found++;
+        catch(const std::runtime_error&){
+            // Missing or stale index is built by the first sieved batch
+        }
+    }
 
-        if(primes_found == nth_prime){
-            std::cout << current << std::endl;
-            return 0;
+    std::ios::sync_with_stdio(false);
+    std::vector<uint64_t> queries;
+    token_reader input;
+    bool invalid = false;
+    std::string invalid_token;
+    for(bool more = true; more;){
+        // Whole batch is read and checked before anything is sieved
+        queries.clear();
+        std::string_view token;
+        while(queries.size() < batch_size && (more = input.next(token))){
+            uint64_t query;
+            if(!parse_query(token, query)){
+                invalid = true;
+                invalid_token = token;
+                more = false;
+                break;
+            }
+            queries.push_back(query);
+        }
+        if(queries.empty()){
+            break;
         }
 
-        int cur_current = current * 2;
-        while(cur_current < array.size()){
-            array[cur_current] = true;
-            cur_current += current;
+        auto largest = *std::max_element(queries.begin(), queries.end());
+        std::vector<uint64_t> answers;
+        window_counts counts;
+        bool sieved = !index || largest > index->total();
+        if(sieved){
+            answers = nth_primes(queries, index_path ? &counts : nullptr);
+        }
+        else{
+            answers = index->nth_primes(queries);
+        }
+        for(auto answer: answers){
+            std::cout << answer << '\n';
         }
+        std::cout.flush();
 
-        current++;
+        // Answers don't need the index, so failing to store it only costs later runs a sieve
+        if(sieved && index_path){
+            try{
+                prime_index::write(index_path, counts);
+                index = std::make_unique<prime_index>(index_path);
+            }
+            catch(const std::runtime_error& error){
+                std::cerr << "warning: " << error.what() << std::endl;
+            }
+        }
+    }
+    if(invalid){
+        std::cerr << "line " << input.line_number() << ": \"" << invalid_token
+                  << "\" isn't a whole number from 1 to " << nth_prime_max << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/// Prints nth prime
+///   main n                        counts primes up to an estimate of it and sieves the rest
+///   main --sieve n [threads]      sieves all numbers up to it, threads default to the number of CPUs
+///   main --batch [index]          answers queries from stdin in one sieve pass per batch,
+///                                 counts of sieved windows are cached in index file for later runs
+/// Build with: c++ -std=c++17 -O2 -pthread main.cc
+int main(int argc, char* argv[]) {
+    if(argc > 1 && std::strcmp(argv[1], "--batch") == 0){
+        try{
+            return answer_batches(argc > 2 ? argv[2] : nullptr);
+        }
+        catch(const std::runtime_error& error){
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+    }
+
+    bool sieve = argc > 1 && std::strcmp(argv[1], "--sieve") == 0;
+    if(argc < 2 + sieve){
+        std::cerr << "usage: " << argv[0] << " n" << std::endl
+                  << "       " << argv[0] << " --sieve n [threads]" << std::endl
+                  << "       " << argv[0] << " --batch [index] < queries" << std::endl;
+        return 1;
+    }
+    uint64_t nth;
+    if(!parse_query(argv[1 + sieve], nth)){
+        std::cerr << "n has to be a whole number from 1 to " << nth_prime_max << std::endl;
+        return 1;
+    }
+
+    if(sieve){
+        unsigned threads = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+        std::cout << nth_prime_sieve(nth, threads) << std::endl;
+    }
+    else{
+        std::cout << nth_prime(nth) << std::endl;
     }
 }
@@ -0,0 +1,125 @@
+#ifndef COMPETITION2_PRIME_COUNT_HH
+#define COMPETITION2_PRIME_COUNT_HH
+
+#include "sieve.hh"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/// Largest r with r * r <= x
+inline uint64_t integer_sqrt(uint64_t x){
+    auto root = static_cast<uint64_t>(std::sqrt(static_cast<double>(x)));
+    while(root * root > x){
+        --root;
+    }
+    while((root + 1) * (root + 1) <= x){
+        ++root;
+    }
+    return root;
+}
+
+/// Number of primes less than or equal to x, Lucy's variant of the Legendre sieve in O(x^(3/4)) time and O(sqrt x) memory
+/// It tracks S(v), the count of numbers in 2 ... v not crossed off yet, only for v = x / k, every other value isn't needed
+inline uint64_t prime_count(uint64_t x){
+    if(x < 2){
+        return 0;
+    }
+    auto root = integer_sqrt(x);
+    // small[v] is S(v) for v <= root, large[k] is S(x / k) for k <= root
+    std::vector<uint64_t> small(root + 1), large(root + 1);
+    for(uint64_t v = 1; v <= root; ++v){
+        small[v] = v - 1;
+        large[v] = x / v - 1;
+    }
+
+    for(uint64_t prime = 2; prime <= root; ++prime){
+        // S didn't drop at prime, so it was crossed off by a smaller one
+        if(small[prime] == small[prime - 1]){
+            continue;
+        }
+        auto smaller_primes = small[prime - 1];
+        auto square = prime * prime;
+        // Crossing off prime removes numbers prime * m where m has no prime factor below prime
+        auto last = std::min(root, x / square);
+        for(uint64_t k = 1; k <= last; ++k){
+            auto d = k * prime;
+            large[k] -= (d <= root ? large[d] : small[x / d]) - smaller_primes;
+        }
+        for(auto v = root; v >= square; --v){
+            small[v] -= small[v / prime] - smaller_primes;
+        }
+    }
+    return large[1];
+}
+
+/// Logarithmic integral li(x) by Ramanujan's series, good to about 1e-12 relative error for x >= 2
+inline double logarithmic_integral(double x){
+    constexpr double euler_mascheroni = 0.57721566490153286061;
+    auto log_x = std::log(x);
+    // Term n is (-1)^(n - 1) (ln x)^n / (n! 2^(n - 1)) times sum of 1 / (2k + 1) over 2k + 1 <= n
+    double sum = 0, inner = 0, power = 1, half = 1;
+    for(int n = 1; n < 200; ++n){
+        power *= log_x / n;
+        if(n % 2 == 1){
+            inner += 1.0 / n;
+        }
+        auto term = (n % 2 == 1 ? 1 : -1) * power * half * inner;
+        sum += term;
+        half /= 2;
+        if(std::abs(term) < 1e-17 * std::abs(sum)){
+            break;
+        }
+    }
+    return euler_mascheroni + std::log(log_x) + std::sqrt(x) * sum;
+}
+
+/// x with li(x) == n by Newton's method, an estimate of nth prime within about sqrt(x) log x
+inline double inverse_logarithmic_integral(double n){
+    auto x = n * std::log(n);
+    for(int iteration = 0; iteration < 50; ++iteration){
+        auto step = (logarithmic_integral(x) - n) * std::log(x);
+        x -= step;
+        if(std::abs(step) < 1){
+            break;
+        }
+    }
+    return x;
+}
+
+/// nth prime counting from one, i.e. nth_prime(1) == 2
+/// Counts primes up to an estimate of nth prime, which is close below it, and sieves only windows from there
+/// n has to be at most nth_prime_max, std::out_of_range is thrown otherwise
+inline uint64_t nth_prime(uint64_t n){
+    // Counting doesn't pay off while the whole sieve takes milliseconds
+    if(n < 100000){
+        return nth_prime_sieve(n);
+    }
+
+    auto limit = nth_prime_upper_bound(n);
+    auto estimate = static_cast<uint64_t>(inverse_logarithmic_integral(static_cast<double>(n)));
+    // Windows cover 2 * segment_bits numbers, the one starting at or below the estimate is sieved first
+    constexpr uint64_t window_numbers = 2 * segmented_sieve::segment_bits;
+    auto window = std::min(estimate, limit) / window_numbers;
+    uint64_t below = window ? prime_count(window * window_numbers - 1) : 0;
+    // li(x) > pi(x) for all x this can handle, so this runs only if the estimate was too far off
+    while(below >= n && window > 0){
+        auto back = std::max<uint64_t>(1, window / 1000);
+        window -= std::min(window, back);
+        below = window ? prime_count(window * window_numbers - 1) : 0;
+    }
+
+    segmented_sieve sieve{limit};
+    sieve.seek(window);
+    n -= below;
+    while(sieve.next_segment()){
+        auto count = sieve.count();
+        if(count >= n){
+            return sieve.nth(n);
+        }
+        n -= count;
+    }
+    return 0;
+}
+
+#endif //COMPETITION2_PRIME_COUNT_HH
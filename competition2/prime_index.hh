@@ -0,0 +1,247 @@
+#ifndef COMPETITION2_PRIME_INDEX_HH
+#define COMPETITION2_PRIME_INDEX_HH
+
+#include "sieve.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Prime counts of consecutive sieve windows, as produced by one sieve pass
+struct window_counts {
+    /// counts[w] is the number of primes in window w
+    std::vector<uint32_t> counts;
+
+    uint64_t total() const {
+        uint64_t result = 0;
+        for(auto count: counts){
+            result += count;
+        }
+        return result;
+    }
+};
+
+/// Answers nth prime queries in one sieve pass up to the largest one, results are in order of queries
+/// Counts of all sieved windows are stored to counts if it isn't null
+inline std::vector<uint64_t> nth_primes(const std::vector<uint64_t>& queries, window_counts* counts = nullptr){
+    std::vector<std::size_t> order(queries.size());
+    for(std::size_t index = 0; index < order.size(); ++index){
+        order[index] = index;
+    }
+    std::sort(order.begin(), order.end(), [&queries](std::size_t lhs, std::size_t rhs){
+        return queries[lhs] < queries[rhs];
+    });
+
+    std::vector<uint64_t> result(queries.size());
+    if(queries.empty()){
+        return result;
+    }
+    segmented_sieve sieve{nth_prime_upper_bound(queries[order.back()])};
+    uint64_t below = 0;
+    auto next = order.begin();
+    while(next != order.end() && sieve.next_segment()){
+        auto count = sieve.count();
+        if(counts){
+            counts->counts.push_back(static_cast<uint32_t>(count));
+        }
+        for(; next != order.end() && queries[*next] <= below + count; ++next){
+            result[*next] = sieve.nth(queries[*next] - below);
+        }
+        below += count;
+    }
+    return result;
+}
+
+/// Prime counts of sieve windows in a file, mapped to memory so a process starts answering right away
+/// Layout, in native byte order as the file is a local cache:
+///   char[8] "PRIMEIDX", uint64 bits per window, uint64 window count W, uint64 checkpoint interval C,
+///   uint64[ceil(W / C)] primes before every C-th window, uint32[W] primes in each window
+/// Checkpoints keep lookups logarithmic while most of the file stays 4 bytes per window
+class prime_index {
+public:
+    constexpr static uint64_t checkpoint_interval = 256;
+
+    /// Maps existing index file, throws std::runtime_error if it can't be read or wasn't made for this sieve
+    explicit prime_index(const std::string& path){
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if(descriptor < 0){
+            throw std::runtime_error("prime_index: can't open " + path);
+        }
+        struct stat status{};
+        if(::fstat(descriptor, &status) != 0 || static_cast<uint64_t>(status.st_size) < header_size){
+            ::close(descriptor);
+            throw std::runtime_error("prime_index: " + path + " is too short");
+        }
+        m_size = status.st_size;
+        auto mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if(mapped == MAP_FAILED){
+            throw std::runtime_error("prime_index: can't map " + path);
+        }
+        m_data = static_cast<const uint8_t*>(mapped);
+
+        if(std::memcmp(m_data, magic, sizeof(magic)) != 0 || field(0) != segmented_sieve::segment_bits ||
+           field(2) != checkpoint_interval || m_size != file_size(field(1))){
+            unmap();
+            throw std::runtime_error("prime_index: " + path + " isn't an index of this sieve");
+        }
+        m_windows = field(1);
+        m_checkpoints = reinterpret_cast<const uint64_t*>(m_data + header_size);
+        m_counts = reinterpret_cast<const uint32_t*>(m_data + header_size + checkpoint_count(m_windows) * sizeof(uint64_t));
+        m_total = m_windows ? primes_before(m_windows - 1) + m_counts[m_windows - 1] : 0;
+    }
+
+    prime_index(const prime_index&) = delete;
+    prime_index& operator=(const prime_index&) = delete;
+
+    ~prime_index(){
+        unmap();
+    }
+
+    /// Writes index of counts to path, throws std::runtime_error if it can't
+    /// The file is written under a temporary name next to path and renamed over it once it is on disk,
+    /// so processes which have the old index mapped keep reading it and nobody sees a partial file
+    static void write(const std::string& path, const window_counts& counts){
+        std::vector<uint64_t> checkpoints;
+        uint64_t below = 0;
+        for(std::size_t window = 0; window < counts.counts.size(); ++window){
+            if(window % checkpoint_interval == 0){
+                checkpoints.push_back(below);
+            }
+            below += counts.counts[window];
+        }
+
+        auto temporary = path + ".tmp." + std::to_string(::getpid());
+        int descriptor = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(descriptor < 0){
+            throw std::runtime_error("prime_index: can't create " + temporary);
+        }
+        uint64_t header[] = {segmented_sieve::segment_bits, counts.counts.size(), checkpoint_interval};
+        bool written = write_all(descriptor, magic, sizeof(magic)) &&
+                       write_all(descriptor, header, sizeof(header)) &&
+                       write_all(descriptor, checkpoints.data(), checkpoints.size() * sizeof(uint64_t)) &&
+                       write_all(descriptor, counts.counts.data(), counts.counts.size() * sizeof(uint32_t)) &&
+                       ::fsync(descriptor) == 0;
+        written = ::close(descriptor) == 0 && written;
+        if(!written || ::rename(temporary.c_str(), path.c_str()) != 0){
+            ::unlink(temporary.c_str());
+            throw std::runtime_error("prime_index: can't write " + path);
+        }
+    }
+
+    uint64_t window_count() const {
+        return m_windows;
+    }
+
+    /// Number of primes in all indexed windows, queries up to it can be answered
+    uint64_t total() const {
+        return m_total;
+    }
+
+    /// Window containing nth prime and the number of primes before it, n has to be at most total()
+    std::pair<uint64_t, uint64_t> find(uint64_t n) const {
+        // Last checkpoint with fewer than n primes before it
+        auto checkpoints = checkpoint_count(m_windows);
+        auto checkpoint = std::upper_bound(m_checkpoints, m_checkpoints + checkpoints, n - 1) - m_checkpoints - 1;
+        auto window = checkpoint * checkpoint_interval;
+        auto below = m_checkpoints[checkpoint];
+        while(below + m_counts[window] < n){
+            below += m_counts[window];
+            ++window;
+        }
+        return {window, below};
+    }
+
+    /// Answers queries covered by the index, sieving only windows containing them
+    std::vector<uint64_t> nth_primes(const std::vector<uint64_t>& queries) const {
+        // Window, primes before it and position of query, sorted so every window is sieved once
+        std::vector<std::tuple<uint64_t, uint64_t, std::size_t>> located;
+        for(std::size_t index = 0; index < queries.size(); ++index){
+            auto [window, below] = find(queries[index]);
+            located.emplace_back(window, below, index);
+        }
+        std::sort(located.begin(), located.end());
+
+        std::vector<uint64_t> result(queries.size());
+        segmented_sieve sieve{m_windows * 2 * segmented_sieve::segment_bits};
+        uint64_t sieved = UINT64_MAX;
+        for(auto [window, below, index]: located){
+            if(window != sieved){
+                sieve.seek(window);
+                sieve.next_segment();
+                sieved = window;
+            }
+            result[index] = sieve.nth(queries[index] - below);
+        }
+        return result;
+    }
+
+private:
+    constexpr static char magic[8] = {'P', 'R', 'I', 'M', 'E', 'I', 'D', 'X'};
+    constexpr static uint64_t header_size = sizeof(magic) + 3 * sizeof(uint64_t);
+
+    const uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+    uint64_t m_windows = 0;
+    uint64_t m_total = 0;
+    const uint64_t* m_checkpoints = nullptr;
+    const uint32_t* m_counts = nullptr;
+
+    static uint64_t checkpoint_count(uint64_t windows){
+        return (windows + checkpoint_interval - 1) / checkpoint_interval;
+    }
+
+    static uint64_t file_size(uint64_t windows){
+        return header_size + checkpoint_count(windows) * sizeof(uint64_t) + windows * sizeof(uint32_t);
+    }
+
+    /// Writes all size bytes, retrying short and interrupted writes
+    static bool write_all(int descriptor, const void* data, std::size_t size){
+        auto bytes = static_cast<const char*>(data);
+        while(size){
+            auto written = ::write(descriptor, bytes, size);
+            if(written < 0 && errno != EINTR){
+                return false;
+            }
+            if(written > 0){
+                bytes += written;
+                size -= written;
+            }
+        }
+        return true;
+    }
+
+    uint64_t field(std::size_t index) const {
+        uint64_t result;
+        std::memcpy(&result, m_data + sizeof(magic) + index * sizeof(uint64_t), sizeof(result));
+        return result;
+    }
+
+    uint64_t primes_before(uint64_t window) const {
+        auto result = m_checkpoints[window / checkpoint_interval];
+        for(auto index = window / checkpoint_interval * checkpoint_interval; index < window; ++index){
+            result += m_counts[index];
+        }
+        return result;
+    }
+
+    void unmap(){
+        if(m_data){
+            ::munmap(const_cast<uint8_t*>(m_data), m_size);
+            m_data = nullptr;
+        }
+    }
+};
+
+#endif //COMPETITION2_PRIME_INDEX_HH
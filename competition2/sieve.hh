@@ -0,0 +1,280 @@
+#ifndef COMPETITION2_SIEVE_HH
+#define COMPETITION2_SIEVE_HH
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Primes less than limit, plain sieve of Eratosthenes, used for primes up to square root of the sieved range
+inline std::vector<uint32_t> small_primes(uint32_t limit){
+    std::vector<bool> composite(limit, false);
+    std::vector<uint32_t> result;
+    for(uint32_t number = 2; number < limit; ++number){
+        if(composite[number]){
+            continue;
+        }
+        result.push_back(number);
+        for(uint64_t multiple = uint64_t{number} * number; multiple < limit; multiple += number){
+            composite[multiple] = true;
+        }
+    }
+    return result;
+}
+
+/// Largest n whose nth prime can be found, the upper bound below for larger n doesn't fit 64 bits
+constexpr uint64_t nth_prime_max = 416'000'000'000'000'000;
+
+/// Upper bound of nth prime, p_n < n (ln n + ln ln n) holds for n >= 6 (Rosser's theorem)
+/// Throws std::out_of_range for n above nth_prime_max
+inline uint64_t nth_prime_upper_bound(uint64_t n){
+    if(n > nth_prime_max){
+        throw std::out_of_range("nth prime: n has to be at most " + std::to_string(nth_prime_max));
+    }
+    if(n < 6){
+        return 13;
+    }
+    auto log_n = std::log(static_cast<double>(n));
+    return static_cast<uint64_t>(n * (log_n + std::log(log_n))) + 1;
+}
+
+/// Sieve of Eratosthenes over consecutive windows small enough to stay in cache
+/// Only primes up to square root of limit and their next multiples are kept besides the window
+/// Window keeps one bit per odd number, set while the number may be prime, so primes are counted by popcount
+/// Multiples of the smallest primes are not crossed off one by one, the window starts as a copy of their pattern
+class segmented_sieve {
+public:
+    /// Window of 32 KiB fits L1 cache of most CPUs, it covers 512 Ki numbers
+    constexpr static uint64_t segment_bytes = 32 * 1024;
+    constexpr static uint64_t segment_bits = segment_bytes * 8;
+
+    /// Sieves numbers less than limit
+    explicit segmented_sieve(uint64_t limit) : m_limit{limit}, m_bits(segment_bytes) {
+        auto root = static_cast<uint64_t>(std::sqrt(static_cast<double>(limit)));
+        while(root * root < limit){
+            ++root;
+        }
+        for(auto prime: small_primes(static_cast<uint32_t>(root + 1))){
+            if(prime > presieved_primes.back()){
+                m_primes.push_back(prime);
+                m_next_multiple.push_back(index_of(uint64_t{prime} * prime));
+            }
+        }
+        make_pattern();
+    }
+
+    /// Number of windows needed to sieve numbers less than limit
+    static uint64_t window_count(uint64_t limit){
+        return (limit / 2 + segment_bits - 1) / segment_bits;
+    }
+
+    /// Makes the given window the next one sieved, windows are numbered from zero
+    void seek(uint64_t window){
+        m_high = window * segment_bits;
+        m_low = m_high;
+        auto start = 2 * m_high;
+        for(std::size_t index = 0; index < m_primes.size(); ++index){
+            uint64_t prime = m_primes[index];
+            auto multiple = (start + prime - 1) / prime * prime;
+            if(multiple % 2 == 0){
+                multiple += prime;
+            }
+            m_next_multiple[index] = index_of(std::max(multiple, prime * prime));
+        }
+    }
+
+    /// Sieves next window, returns false once the whole range was sieved
+    bool next_segment(){
+        // Odd numbers less than limit have indices less than limit / 2
+        if(m_high >= m_limit / 2){
+            return false;
+        }
+        m_low = m_high;
+        m_high = std::min(m_low + segment_bits, m_limit / 2);
+        copy_pattern();
+
+        for(std::size_t index = 0; index < m_primes.size(); ++index){
+            auto multiple = m_next_multiple[index];
+            // Consecutive odd multiples of a prime are the prime apart in indices
+            for(; multiple < m_high; multiple += m_primes[index]){
+                m_bits[(multiple - m_low) / 8] &= static_cast<uint8_t>(~(1 << ((multiple - m_low) % 8)));
+            }
+            m_next_multiple[index] = multiple;
+        }
+
+        if(m_low == 0){
+            // 1 isn't prime, the presieved primes were crossed off by their own pattern
+            m_bits[0] &= static_cast<uint8_t>(~1);
+            for(auto prime: presieved_primes){
+                if(index_of(prime) < m_high){
+                    m_bits[index_of(prime) / 8] |= static_cast<uint8_t>(1 << (index_of(prime) % 8));
+                }
+            }
+        }
+        // Bits past limit are cleared, so whole words can be counted
+        auto used_bits = m_high - m_low;
+        if(used_bits % 8){
+            m_bits[used_bits / 8] &= static_cast<uint8_t>((1 << (used_bits % 8)) - 1);
+        }
+        std::fill(m_bits.begin() + (used_bits + 7) / 8, m_bits.end(), 0);
+        return true;
+    }
+
+    /// Smallest number of current window
+    uint64_t low() const {
+        return 2 * m_low;
+    }
+
+    /// Number after the largest number of current window
+    uint64_t high() const {
+        return std::min(2 * m_high, m_limit);
+    }
+
+    /// Number of primes in current window
+    uint64_t count() const {
+        uint64_t result = has_two() ? 1 : 0;
+        for(std::size_t word = 0; word < segment_bytes / 8; ++word){
+            result += __builtin_popcountll(load_word(word));
+        }
+        return result;
+    }
+
+    /// k-th prime of current window counting from one, there have to be at least k primes in it
+    uint64_t nth(uint64_t k) const {
+        if(has_two() && k-- == 1){
+            return 2;
+        }
+        std::size_t word = 0;
+        for(uint64_t count; (count = __builtin_popcountll(load_word(word))) < k; ++word){
+            k -= count;
+        }
+        std::size_t byte = word * 8;
+        for(uint64_t count; (count = __builtin_popcount(m_bits[byte])) < k; ++byte){
+            k -= count;
+        }
+        unsigned bits = m_bits[byte];
+        for(; k > 1; --k){
+            bits &= bits - 1;
+        }
+        return 2 * (m_low + byte * 8 + __builtin_ctz(bits)) + 1;
+    }
+
+private:
+    /// Primes whose multiples are copied from the pattern, the pattern repeats after their product
+    constexpr static std::array<uint32_t, 5> presieved_primes = {3, 5, 7, 11, 13};
+    constexpr static std::size_t pattern_period = 3 * 5 * 7 * 11 * 13;
+
+    uint64_t m_limit;
+    /// Current window holds odd numbers with indices m_low ... m_high - 1, number 2i + 1 has index i
+    uint64_t m_low = 0;
+    uint64_t m_high = 0;
+    std::vector<uint32_t> m_primes;
+    /// Index of next odd multiple of each prime which wasn't crossed off yet
+    std::vector<uint64_t> m_next_multiple;
+    std::vector<uint8_t> m_bits;
+    /// Period of pattern in bits is pattern_period, so in bytes it is pattern_period too
+    /// Pattern is stored twice, so copies of up to one period can start anywhere in the first one
+    std::vector<uint8_t> m_pattern;
+
+    static uint64_t index_of(uint64_t odd_number){
+        return odd_number / 2;
+    }
+
+    bool has_two() const {
+        return m_low == 0 && m_limit > 2;
+    }
+
+    /// Bytes of word are loaded in any order, which doesn't matter for popcount
+    uint64_t load_word(std::size_t word) const {
+        uint64_t result;
+        std::memcpy(&result, m_bits.data() + 8 * word, sizeof(result));
+        return result;
+    }
+
+    void make_pattern(){
+        m_pattern.assign(2 * pattern_period, 0);
+        for(std::size_t index = 0; index < 2 * pattern_period * 8; ++index){
+            auto number = 2 * index + 1;
+            bool candidate = std::none_of(presieved_primes.begin(), presieved_primes.end(), [number](uint32_t prime){
+                return number % prime == 0;
+            });
+            m_pattern[index / 8] |= static_cast<uint8_t>(candidate << (index % 8));
+        }
+    }
+
+    /// Window starts at index divisible by 8, so its first byte is some byte of the pattern
+    void copy_pattern(){
+        auto offset = m_low / 8 % pattern_period;
+        for(std::size_t position = 0; position < segment_bytes;){
+            auto length = std::min<std::size_t>(segment_bytes - position, pattern_period);
+            std::memcpy(m_bits.data() + position, m_pattern.data() + offset, length);
+            position += length;
+            offset = (offset + length) % pattern_period;
+        }
+    }
+};
+
+/// nth prime counting from one, i.e. nth_prime_sieve(1) == 2, found by sieving all numbers up to it
+/// n has to be at most nth_prime_max, std::out_of_range is thrown otherwise
+inline uint64_t nth_prime_sieve(uint64_t n){
+    segmented_sieve sieve{nth_prime_upper_bound(n)};
+    while(sieve.next_segment()){
+        auto count = sieve.count();
+        if(count >= n){
+            return sieve.nth(n);
+        }
+        n -= count;
+    }
+    return 0;
+}
+
+/// nth prime found by several threads, each sieving chunks of consecutive windows and storing their prime counts
+/// Prefix sums of the counts then tell the window with nth prime, which is sieved once more to find it
+inline uint64_t nth_prime_sieve(uint64_t n, unsigned threads){
+    if(threads <= 1){
+        return nth_prime_sieve(n);
+    }
+    // Chunk is 64 windows, i.e. 32 Mi numbers, enough to pay for seeking all primes to its start
+    constexpr uint64_t chunk_windows = 64;
+    auto limit = nth_prime_upper_bound(n);
+    auto windows = segmented_sieve::window_count(limit);
+    std::vector<uint64_t> counts(windows);
+    std::atomic<uint64_t> next_chunk{0};
+
+    auto worker = [&counts, &next_chunk, limit, windows]{
+        segmented_sieve sieve{limit};
+        for(uint64_t first; (first = next_chunk++ * chunk_windows) < windows;){
+            sieve.seek(first);
+            for(auto window = first; window < std::min(first + chunk_windows, windows) && sieve.next_segment(); ++window){
+                counts[window] = sieve.count();
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for(unsigned thread = 1; thread < threads; ++thread){
+        workers.emplace_back(worker);
+    }
+    worker();
+    for(auto& thread: workers){
+        thread.join();
+    }
+
+    for(uint64_t window = 0; window < windows; ++window){
+        if(counts[window] >= n){
+            segmented_sieve sieve{limit};
+            sieve.seek(window);
+            sieve.next_segment();
+            return sieve.nth(n);
+        }
+        n -= counts[window];
+    }
+    return 0;
+}
+
+#endif //COMPETITION2_SIEVE_HH
@@ -0,0 +1,177 @@
+#ifndef COMPETITION3_LEAST_SQUARES_HH
+#define COMPETITION3_LEAST_SQUARES_HH
+
+#include "simd.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace regression_detail {
+
+inline double dot_scalar(const double* lhs, const double* rhs, std::size_t size){
+    double result = 0;
+    for(std::size_t index = 0; index < size; ++index){
+        result += lhs[index] * rhs[index];
+    }
+    return result;
+}
+
+#ifdef REGRESSION_X86_KERNELS
+/// Four independent FMA chains hide their latency
+__attribute__((target("avx2,fma")))
+inline double dot_avx2(const double* lhs, const double* rhs, std::size_t size){
+    __m256d sum[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+    std::size_t index = 0;
+    for(; index + 16 <= size; index += 16){
+        for(int chain = 0; chain < 4; ++chain){
+            sum[chain] = _mm256_fmadd_pd(_mm256_loadu_pd(lhs + index + 4 * chain),
+                                         _mm256_loadu_pd(rhs + index + 4 * chain), sum[chain]);
+        }
+    }
+    auto total = _mm256_add_pd(_mm256_add_pd(sum[0], sum[1]), _mm256_add_pd(sum[2], sum[3]));
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dot_scalar(lhs + index, rhs + index, size - index);
+}
+#endif
+
+inline double dot(const double* lhs, const double* rhs, std::size_t size){
+    switch(active_simd()){
+#ifdef REGRESSION_X86_KERNELS
+        case simd::avx2_fma: return dot_avx2(lhs, rhs, size);
+#endif
+        default: return dot_scalar(lhs, rhs, size);
+    }
+}
+
+}
+
+/// Least squares fit of y = b + a_1 x_1 + ... + a_p x_p by the normal equations, rows are streamed and never stored
+/// Accumulates the Gram matrix of rows (1, x_1 ... x_p, y), which holds both X^T X and X^T y
+/// Rows are collected into blocks stored column by column and added to the matrix as dot products of columns,
+/// so every column of a block is loaded from cache once per tile of columns instead of once per row
+/// Values are taken relative to the first row, like in regression_accumulator offsets would cancel otherwise
+class least_squares {
+public:
+    /// Rows per block, a block of 32 columns still fits L2 cache
+    constexpr static std::size_t block_rows = 256;
+
+    explicit least_squares(std::size_t regressors)
+        : m_columns{regressors + 2}, m_block(m_columns * block_rows), m_shift(m_columns), m_gram(m_columns * m_columns) {
+        std::fill(m_block.begin(), m_block.begin() + block_rows, 1.0);
+    }
+
+    std::size_t regressors() const {
+        return m_columns - 2;
+    }
+
+    /// Adds row x_1 ... x_p given by x, and y
+    void add(const double* x, double y){
+        if(m_count == 0){
+            std::copy(x, x + regressors(), m_shift.begin() + 1);
+            m_shift.back() = y;
+        }
+        for(std::size_t column = 1; column + 1 < m_columns; ++column){
+            m_block[column * block_rows + m_rows] = x[column - 1] - m_shift[column];
+        }
+        m_block[(m_columns - 1) * block_rows + m_rows] = y - m_shift.back();
+        ++m_count;
+        if(++m_rows == block_rows){
+            accumulate(m_gram);
+            m_rows = 0;
+        }
+    }
+
+    uint64_t count() const {
+        return m_count;
+    }
+
+    /// Coefficients b, a_1 ... a_p, all NaN if they aren't determined by the rows (fewer rows than coefficients,
+    /// or a regressor is a combination of the others)
+    std::vector<double> result() const {
+        auto gram = m_gram;
+        accumulate(gram);
+
+        // Cholesky factor of X^T X in place, L is in the lower triangle, the upper one holds the sums
+        auto size = m_columns - 1;
+        auto at = [&gram, this](std::size_t row, std::size_t column) -> double& {
+            return gram[row * m_columns + column];
+        };
+        std::vector<double> result(size, std::numeric_limits<double>::quiet_NaN());
+        for(std::size_t column = 0; column < size; ++column){
+            auto diagonal = at(column, column);
+            for(std::size_t k = 0; k < column; ++k){
+                diagonal -= at(column, k) * at(column, k);
+            }
+            // Pivot lost to rounding relative to the original sum means a dependent column
+            if(!(diagonal > 1e-14 * at(column, column))){
+                return result;
+            }
+            diagonal = std::sqrt(diagonal);
+            at(column, column) = diagonal;
+            for(auto row = column + 1; row < size; ++row){
+                auto value = at(column, row);
+                for(std::size_t k = 0; k < column; ++k){
+                    value -= at(row, k) * at(column, k);
+                }
+                at(row, column) = value / diagonal;
+            }
+        }
+
+        // L z = X^T y, then L^T c = z
+        std::vector<double> solution(size);
+        for(std::size_t row = 0; row < size; ++row){
+            auto value = at(row, size);
+            for(std::size_t k = 0; k < row; ++k){
+                value -= at(row, k) * solution[k];
+            }
+            solution[row] = value / at(row, row);
+        }
+        for(auto row = size; row-- > 0;){
+            auto value = solution[row];
+            for(auto k = row + 1; k < size; ++k){
+                value -= at(k, row) * solution[k];
+            }
+            solution[row] = value / at(row, row);
+        }
+
+        // Fit was of y - shift_y on x - shift_x, which moves only the intercept
+        solution[0] += m_shift.back();
+        for(std::size_t column = 1; column < size; ++column){
+            solution[0] -= solution[column] * m_shift[column];
+        }
+        return solution;
+    }
+
+private:
+    /// Columns 1, x_1 ... x_p, y
+    std::size_t m_columns;
+    /// Block of rows stored column by column, column 0 is all ones
+    std::vector<double> m_block;
+    std::size_t m_rows = 0;
+    std::vector<double> m_shift;
+    /// Upper triangle of the Gram matrix, row by row
+    std::vector<double> m_gram;
+    uint64_t m_count = 0;
+
+    /// Adds products of columns of the rows in block to the upper triangle of gram, in tiles of columns
+    void accumulate(std::vector<double>& gram) const {
+        constexpr std::size_t tile = 8;
+        for(std::size_t first_row = 0; first_row < m_columns; first_row += tile){
+            for(auto first_column = first_row; first_column < m_columns; first_column += tile){
+                for(auto row = first_row; row < std::min(first_row + tile, m_columns); ++row){
+                    for(auto column = std::max(row, first_column); column < std::min(first_column + tile, m_columns); ++column){
+                        gram[row * m_columns + column] += regression_detail::dot(
+                            m_block.data() + row * block_rows, m_block.data() + column * block_rows, m_rows);
+                    }
+                }
+            }
+        }
+    }
+};
+
+#endif //COMPETITION3_LEAST_SQUARES_HH
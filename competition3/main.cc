@@ -1,35 +1,136 @@
-#include <utility>
-#include <vector>
+#include "least_squares.hh"
+#include "number_reader.hh"
+#include "parallel_regression.hh"
+#include "regression.hh"
+#include "window_regression.hh"
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <system_error>
+#include <thread>
+#include <vector>
 
-int main(int argc, char* argv[]) {
-    std::vector<std::pair<double, double>> data;
+#include <unistd.h>
 
-    for(double in1, in2; std::cin >> in1 && std::cin >> in2;){
-        data.emplace_back(in1, in2);
+/// Parses whole argument as a number, returns false if it isn't one of type T
+template<typename T>
+bool parse_argument(const char* argument, T& value){
+    auto last = argument + std::strlen(argument);
+    auto [end, error] = std::from_chars(argument, last, value);
+    return error == std::errc{} && end == last;
+}
+
+/// Fits y = a x + b by least squares to pairs x y read from stdin, prints b and a
+///   main                  points are added to the fit while reading, input of any size takes constant memory
+///   main --threads [n]    stdin which is a file is mapped and split among n threads, default is the number of CPUs
+///                         other input, like a pipe, is read as without the option
+///   main --window w [--every k] [--decay d]
+///                         fits the last w points of a stream (all of them if w is 0) and prints "b a" after every
+///                         k points, 1 by default; with decay each point weighs d times less for every newer one
+///                         --every and --decay need --window, --threads, --window and --columns exclude each other
+///   main --columns p      fits y = b + a_1 x_1 + ... + a_p x_p to rows x_1 ... x_p y, prints b and a_1 ... a_p
+/// Build with: c++ -std=c++17 -O2 -pthread main.cc
+int main(int argc, char* argv[]) {
+    unsigned threads = 0;
+    bool threaded = false;
+    bool windowed = false;
+    std::size_t window = 0;
+    bool has_every = false;
+    uint64_t every = 1;
+    bool has_decay = false;
+    double decay = 1;
+    bool has_columns = false;
+    std::size_t columns = 1;
+    bool valid = true;
+    for(int arg = 1; arg < argc && valid; ++arg){
+        const char* value = arg + 1 < argc ? argv[arg + 1] : nullptr;
+        if(std::strcmp(argv[arg], "--threads") == 0){
+            threaded = true;
+            threads = std::thread::hardware_concurrency();
+            // Count of threads is optional, the next argument is taken only if it is a number
+            if(value && parse_argument(value, threads)){
+                ++arg;
+            }
+        }
+        else if(!value){
+            valid = false;
+        }
+        else if(std::strcmp(argv[arg], "--window") == 0){
+            windowed = true;
+            valid = parse_argument(value, window);
+            ++arg;
+        }
+        else if(std::strcmp(argv[arg], "--every") == 0){
+            has_every = true;
+            valid = parse_argument(value, every) && every > 0;
+            ++arg;
+        }
+        else if(std::strcmp(argv[arg], "--decay") == 0){
+            has_decay = true;
+            valid = parse_argument(value, decay) && decay > 0 && decay <= 1;
+            ++arg;
+        }
+        else if(std::strcmp(argv[arg], "--columns") == 0){
+            has_columns = true;
+            valid = parse_argument(value, columns) && columns > 0;
+            ++arg;
+        }
+        else{
+            valid = false;
+        }
+    }
+    // Options which don't go together are refused, silently ignoring one would print a different fit than asked for
+    valid = valid && threaded + windowed + has_columns <= 1 && (windowed || !(has_every || has_decay));
+    if(!valid){
+        std::cerr << "usage: " << argv[0] << " [--threads [n]] < points" << std::endl
+                  << "       " << argv[0] << " --window w [--every k] [--decay d] < points" << std::endl
+                  << "       " << argv[0] << " --columns p < rows" << std::endl
+                  << "k and p have to be positive, d has to be in (0, 1]" << std::endl;
+        return 1;
     }
 
-    auto n = std::size(data);
-
-    double sumx = 0;
-    double sumx2 = 0;
-    double sumxy = 0;
-    double sumy = 0;
-    double sumy2 = 0;
-    for(unsigned c = 0; c < n; ++c){
-        sumx += data[c].first;
-        sumx2 += data[c].first * data[c].first;
-        sumxy += data[c].first * data[c].second;
-        sumy += data[c].second;
-        sumy2 += data[c].second * data[c].second;
+    number_reader input{STDIN_FILENO};
+    if(windowed){
+        window_regression fit{window, decay};
+        report_every(fit, every, [&input](double& value){ return input.next(value); }, [](line result){
+            std::cout << result.intercept << ' ' << result.slope << std::endl;
+        });
+        return 0;
     }
 
-    double det = n * sumx2 - sumx * sumx;
+    // One regressor goes through the co-moment accumulator, it doesn't have to solve equations
+    if(columns > 1){
+        least_squares fit{columns};
+        std::vector<double> row(columns + 1);
+        for(;;){
+            std::size_t read = 0;
+            while(read < row.size() && input.next(row[read])){
+                ++read;
+            }
+            if(read < row.size()){
+                break;
+            }
+            fit.add(row.data(), row.back());
+        }
+        for(auto coefficient: fit.result()){
+            std::cout << coefficient << std::endl;
+        }
+        return 0;
+    }
 
-    double a = (n * sumxy - sumx * sumy) / det;
-    double b = (sumy * sumx2 - sumx * sumxy) / det;
+    regression_accumulator fit;
+    mapped_input mapped{STDIN_FILENO};
+    if(threads && mapped){
+        fit = fit_parallel(mapped.data(), mapped.size(), threads);
+    }
+    else{
+        for(double x, y; input.next(x) && input.next(y);){
+            fit.add(x, y);
+        }
+    }
 
+    auto [b, a] = fit.result();
     std::cout << b << std::endl << a << std::endl;
-
-
 }
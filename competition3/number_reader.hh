@@ -0,0 +1,108 @@
+#ifndef COMPETITION3_NUMBER_READER_HH
+#define COMPETITION3_NUMBER_READER_HH
+
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <cerrno>
+#include <unistd.h>
+
+inline bool is_space(char c){
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/// Parses whole token first ... last - 1 as a number, returns false if it isn't one
+inline bool parse_number(const char* first, const char* last, double& value){
+    // from_chars doesn't take plus sign
+    if(first != last && *first == '+'){
+        ++first;
+    }
+    auto [end, error] = std::from_chars(first, last, value);
+    return error == std::errc{} && end == last;
+}
+
+/// Reads whitespace separated numbers from a file descriptor in large chunks, nothing but the current chunk is kept
+/// Numbers are parsed by std::from_chars, which rounds correctly and doesn't touch locale or stream state
+class number_reader {
+public:
+    /// Chunk of 1 MiB keeps system calls rare and still fits L2 cache
+    constexpr static std::size_t chunk_bytes = 1 << 20;
+
+    explicit number_reader(int descriptor) : m_descriptor{descriptor}, m_buffer(chunk_bytes) {}
+
+    /// Reads next number, returns false at end of input or at anything which isn't a number, like std::cin does
+    bool next(double& value){
+        skip_spaces();
+        if(m_position == m_end){
+            return false;
+        }
+        auto token_end = find_space(m_position);
+        // Token may continue in the next chunk unless the input ended
+        while(token_end == m_end && !m_eof){
+            auto offset = token_end - m_position;
+            refill();
+            token_end = find_space(m_position + offset);
+        }
+
+        if(!parse_number(m_position, token_end, value)){
+            m_position = m_end;
+            return false;
+        }
+        m_position = token_end;
+        return true;
+    }
+
+private:
+    int m_descriptor;
+    std::vector<char> m_buffer;
+    const char* m_position = nullptr;
+    const char* m_end = nullptr;
+    bool m_eof = false;
+
+    void skip_spaces(){
+        for(;;){
+            while(m_position != m_end && is_space(*m_position)){
+                ++m_position;
+            }
+            if(m_position != m_end || m_eof){
+                return;
+            }
+            refill();
+        }
+    }
+
+    const char* find_space(const char* from) const {
+        while(from != m_end && !is_space(*from)){
+            ++from;
+        }
+        return from;
+    }
+
+    /// Moves unread bytes to the front and reads more after them, the buffer grows only for tokens longer than a chunk
+    /// Takes whatever one read returns, so numbers from a pipe are seen as soon as they arrive
+    void refill(){
+        std::size_t kept = m_end - m_position;
+        if(kept){
+            std::memmove(m_buffer.data(), m_position, kept);
+        }
+        if(kept == m_buffer.size()){
+            m_buffer.resize(2 * m_buffer.size());
+        }
+        ssize_t bytes;
+        while((bytes = ::read(m_descriptor, m_buffer.data() + kept, m_buffer.size() - kept)) < 0){
+            if(errno != EINTR){
+                throw std::runtime_error(std::string("number_reader: ") + std::strerror(errno));
+            }
+        }
+        m_eof = bytes == 0;
+        m_position = m_buffer.data();
+        m_end = m_buffer.data() + kept + bytes;
+    }
+};
+
+#endif //COMPETITION3_NUMBER_READER_HH
@@ -0,0 +1,317 @@
+#ifndef COMPETITION3_PARALLEL_REGRESSION_HH
+#define COMPETITION3_PARALLEL_REGRESSION_HH
+
+#include "number_reader.hh"
+#include "regression.hh"
+#include "simd.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace regression_detail {
+
+/// Sums of dx, dy, dx^2 and dx dy of points' deviations from a shift, each with Kahan compensation
+struct shifted_sums {
+    double shift_x = 0;
+    double shift_y = 0;
+    uint64_t count = 0;
+    std::array<double, 4> sum{};
+    /// Rounding error of each sum, sum - compensation is the more exact value
+    std::array<double, 4> compensation{};
+
+    void add_term(std::size_t index, double term){
+        auto corrected = term - compensation[index];
+        auto next = sum[index] + corrected;
+        compensation[index] = (next - sum[index]) - corrected;
+        sum[index] = next;
+    }
+
+    regression_accumulator result() const {
+        return regression_accumulator::from_shifted_sums(count, shift_x, shift_y, sum[0], sum[1], sum[2], sum[3]);
+    }
+};
+
+inline void add_points_scalar(shifted_sums& sums, const double* xs, const double* ys, std::size_t size){
+    for(std::size_t index = 0; index < size; ++index){
+        auto dx = xs[index] - sums.shift_x;
+        auto dy = ys[index] - sums.shift_y;
+        sums.add_term(0, dx);
+        sums.add_term(1, dy);
+        sums.add_term(2, dx * dx);
+        sums.add_term(3, dx * dy);
+    }
+    sums.count += size;
+}
+
+#ifdef REGRESSION_X86_KERNELS
+__attribute__((target("avx2")))
+inline void add_term_avx2(__m256d& sum, __m256d& compensation, __m256d corrected){
+    auto next = _mm256_add_pd(sum, corrected);
+    compensation = _mm256_sub_pd(_mm256_sub_pd(next, sum), corrected);
+    sum = next;
+}
+
+/// Four compensated sums per lane, products are computed and compensated in one rounding by FMA
+/// Lanes are folded into the scalar sums at the end, whatever is left of the block goes through the scalar loop
+__attribute__((target("avx2,fma")))
+inline void add_points_avx2(shifted_sums& sums, const double* xs, const double* ys, std::size_t size){
+    auto shift_x = _mm256_set1_pd(sums.shift_x);
+    auto shift_y = _mm256_set1_pd(sums.shift_y);
+    __m256d sum[4], compensation[4];
+    for(int index = 0; index < 4; ++index){
+        sum[index] = _mm256_setzero_pd();
+        compensation[index] = _mm256_setzero_pd();
+    }
+    std::size_t index = 0;
+    for(; index + 4 <= size; index += 4){
+        auto dx = _mm256_sub_pd(_mm256_loadu_pd(xs + index), shift_x);
+        auto dy = _mm256_sub_pd(_mm256_loadu_pd(ys + index), shift_y);
+        add_term_avx2(sum[0], compensation[0], _mm256_sub_pd(dx, compensation[0]));
+        add_term_avx2(sum[1], compensation[1], _mm256_sub_pd(dy, compensation[1]));
+        add_term_avx2(sum[2], compensation[2], _mm256_fmsub_pd(dx, dx, compensation[2]));
+        add_term_avx2(sum[3], compensation[3], _mm256_fmsub_pd(dx, dy, compensation[3]));
+    }
+
+    for(int quantity = 0; quantity < 4; ++quantity){
+        alignas(32) double lanes[4], errors[4];
+        _mm256_store_pd(lanes, sum[quantity]);
+        _mm256_store_pd(errors, compensation[quantity]);
+        for(int lane = 0; lane < 4; ++lane){
+            sums.add_term(quantity, lanes[lane]);
+            sums.add_term(quantity, -errors[lane]);
+        }
+    }
+    sums.count += index;
+    add_points_scalar(sums, xs + index, ys + index, size - index);
+}
+#endif
+
+/// Adds points given as separate arrays of x and y (structure of arrays, so each load fills a vector)
+inline void add_points(shifted_sums& sums, const double* xs, const double* ys, std::size_t size){
+    switch(active_simd()){
+#ifdef REGRESSION_X86_KERNELS
+        case simd::avx2_fma: add_points_avx2(sums, xs, ys, size); return;
+#endif
+        default: add_points_scalar(sums, xs, ys, size); return;
+    }
+}
+
+inline uint64_t count_tokens(const char* first, const char* last){
+    uint64_t result = 0;
+    bool in_token = false;
+    for(; first != last; ++first){
+        bool space = is_space(*first);
+        result += !in_token && !space;
+        in_token = !space;
+    }
+    return result;
+}
+
+/// Fit of the pairs in one chunk of text, whose ends are at token boundaries
+/// If the chunk starts in the middle of a pair, its first number is the y of an x at the end of a previous chunk
+struct chunk_fit {
+    regression_accumulator fit;
+    /// Stopped at a token which isn't a number, the rest of the input doesn't count
+    bool failed = false;
+    bool has_head = false;
+    double head = 0;
+    bool has_tail = false;
+    double tail = 0;
+};
+
+inline chunk_fit fit_chunk(const char* first, const char* last, bool starts_with_x){
+    // Pairs are collected into blocks, small enough for the stack and large enough to amortize folding of lanes
+    constexpr std::size_t block_size = 1024;
+    double xs[block_size], ys[block_size];
+    std::size_t filled = 0;
+    bool has_x = false;
+    shifted_sums sums;
+    chunk_fit result;
+
+    auto flush = [&]{
+        if(sums.count == 0 && filled){
+            // Deviations from the first point are small wherever the data doesn't drift much within a chunk
+            sums.shift_x = xs[0];
+            sums.shift_y = ys[0];
+        }
+        add_points(sums, xs, ys, filled);
+        filled = 0;
+    };
+
+    for(;;){
+        while(first != last && is_space(*first)){
+            ++first;
+        }
+        if(first == last){
+            break;
+        }
+        auto token_end = first;
+        while(token_end != last && !is_space(*token_end)){
+            ++token_end;
+        }
+        double value;
+        if(!parse_number(first, token_end, value)){
+            result.failed = true;
+            has_x = false;
+            break;
+        }
+        first = token_end;
+
+        if(!starts_with_x){
+            result.has_head = true;
+            result.head = value;
+            starts_with_x = true;
+        }
+        else if(!has_x){
+            xs[filled] = value;
+            has_x = true;
+        }
+        else{
+            ys[filled++] = value;
+            has_x = false;
+            if(filled == block_size){
+                flush();
+            }
+        }
+    }
+    if(has_x){
+        result.has_tail = true;
+        result.tail = xs[filled];
+    }
+    flush();
+    result.fit = sums.result();
+    return result;
+}
+
+/// Runs task(index) for index in 0 ... count - 1 on the given number of threads, each takes the next index when done
+template<typename Task>
+void run_parallel(std::size_t count, unsigned threads, Task task){
+    std::atomic<std::size_t> next{0};
+    auto worker = [&next, &task, count]{
+        for(std::size_t index; (index = next++) < count;){
+            task(index);
+        }
+    };
+    std::vector<std::thread> workers;
+    for(unsigned thread = 1; thread < threads; ++thread){
+        workers.emplace_back(worker);
+    }
+    worker();
+    for(auto& thread: workers){
+        thread.join();
+    }
+}
+
+}
+
+/// Fits a line to pairs x y in text data by several threads, same as adding all pairs in order to one accumulator
+/// Text is cut into chunks at whitespace, tokens are counted in each to know which of them start with x,
+/// then chunks are parsed and reduced independently and their accumulators merged
+inline regression_accumulator fit_parallel(const char* data, std::size_t size, unsigned threads){
+    using namespace regression_detail;
+    // Chunks of 16 MiB are plenty to share among threads and cost little to count twice
+    constexpr std::size_t chunk_bytes = 16 << 20;
+    std::vector<std::size_t> bounds{0};
+    while(bounds.back() != size){
+        auto bound = std::min(bounds.back() + chunk_bytes, size);
+        while(bound != size && !is_space(data[bound])){
+            ++bound;
+        }
+        bounds.push_back(bound);
+    }
+    auto chunks = bounds.size() - 1;
+
+    std::vector<uint64_t> tokens(chunks);
+    run_parallel(chunks, threads, [&](std::size_t chunk){
+        tokens[chunk] = count_tokens(data + bounds[chunk], data + bounds[chunk + 1]);
+    });
+    std::vector<chunk_fit> fits(chunks);
+    std::vector<bool> starts_with_x(chunks);
+    for(std::size_t chunk = 0, before = 0; chunk < chunks; before += tokens[chunk++]){
+        starts_with_x[chunk] = before % 2 == 0;
+    }
+    run_parallel(chunks, threads, [&](std::size_t chunk){
+        fits[chunk] = fit_chunk(data + bounds[chunk], data + bounds[chunk + 1], starts_with_x[chunk]);
+    });
+
+    // Pairs split between chunks are added separately
+    regression_accumulator result;
+    bool has_x = false;
+    double x = 0;
+    for(std::size_t chunk = 0; chunk < chunks; ++chunk){
+        if(tokens[chunk] == 0){
+            continue;
+        }
+        auto& fit = fits[chunk];
+        if(fit.has_head && has_x){
+            result.add(x, fit.head);
+        }
+        result.merge(fit.fit);
+        if(fit.failed){
+            break;
+        }
+        has_x = fit.has_tail;
+        x = fit.tail;
+    }
+    return result;
+}
+
+/// Read-only mapping of a regular file, empty if the descriptor is something else, like a pipe
+class mapped_input {
+public:
+    explicit mapped_input(int descriptor){
+        struct stat status{};
+        if(::fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode)){
+            return;
+        }
+        m_regular = true;
+        m_size = status.st_size;
+        if(m_size == 0){
+            return;
+        }
+        auto mapped = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(mapped == MAP_FAILED){
+            m_regular = false;
+            m_size = 0;
+            return;
+        }
+        ::madvise(mapped, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(mapped);
+    }
+
+    mapped_input(const mapped_input&) = delete;
+    mapped_input& operator=(const mapped_input&) = delete;
+
+    ~mapped_input(){
+        if(m_data){
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    explicit operator bool() const {
+        return m_regular;
+    }
+
+    const char* data() const {
+        return m_data;
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+private:
+    bool m_regular = false;
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+#endif //COMPETITION3_PARALLEL_REGRESSION_HH
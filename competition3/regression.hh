@@ -0,0 +1,123 @@
+#ifndef COMPETITION3_REGRESSION_HH
+#define COMPETITION3_REGRESSION_HH
+
+#include <cstdint>
+
+/// Coefficients of the line y = slope x + intercept
+struct line {
+    double intercept;
+    double slope;
+};
+
+/// Weighted least squares fit of a line, updated one point at a time
+/// Keeps means and sums of products of deviations from them (co-moments, Welford's method) instead of raw sums,
+/// so nothing cancels when x or y are far from zero compared to their spread
+/// Means are kept relative to the first point, like in from_shifted_sums, a mean close to 1e9 would otherwise
+/// round every update to its own ulp and drift on long sorted input
+/// Accumulators of disjoint parts of the data can be merged, the result is the same as for one over all of it
+class regression_accumulator {
+public:
+    void add(double x, double y, double weight = 1){
+        if(m_weight == 0){
+            m_shift_x = x;
+            m_shift_y = y;
+        }
+        x -= m_shift_x;
+        y -= m_shift_y;
+        m_weight += weight;
+        auto dx = x - m_mean_x;
+        m_mean_x += dx * weight / m_weight;
+        m_mean_y += (y - m_mean_y) * weight / m_weight;
+        // Old deviation of x times new ones, which is the exact update of the sums
+        m_m2_x += weight * dx * (x - m_mean_x);
+        m_c_xy += weight * dx * (y - m_mean_y);
+    }
+
+    /// Takes back a point added before with the same weight, add run backwards
+    void remove(double x, double y, double weight = 1){
+        if(weight >= m_weight){
+            *this = {};
+            return;
+        }
+        x -= m_shift_x;
+        y -= m_shift_y;
+        auto dx = x - m_mean_x;
+        auto dy = y - m_mean_y;
+        m_weight -= weight;
+        m_mean_x -= dx * weight / m_weight;
+        m_mean_y -= dy * weight / m_weight;
+        m_m2_x -= weight * (x - m_mean_x) * dx;
+        m_c_xy -= weight * (x - m_mean_x) * dy;
+    }
+
+    /// Multiplies weights of all points added so far by factor, exponential forgetting if done before every add
+    void decay(double factor){
+        m_weight *= factor;
+        m_m2_x *= factor;
+        m_c_xy *= factor;
+    }
+
+    /// Adds all points of other, Chan's formula for pairwise combination of co-moments
+    void merge(const regression_accumulator& other){
+        if(other.m_weight == 0){
+            return;
+        }
+        if(m_weight == 0){
+            *this = other;
+            return;
+        }
+        auto weight = m_weight + other.m_weight;
+        // Means of other relative to our shift, shifts of nearby parts are close, so their difference is exact
+        auto dx = other.m_mean_x + (other.m_shift_x - m_shift_x) - m_mean_x;
+        auto dy = other.m_mean_y + (other.m_shift_y - m_shift_y) - m_mean_y;
+        auto product = m_weight * other.m_weight / weight;
+        m_mean_x += dx * other.m_weight / weight;
+        m_mean_y += dy * other.m_weight / weight;
+        m_m2_x += other.m_m2_x + dx * dx * product;
+        m_c_xy += other.m_c_xy + dx * dy * product;
+        m_weight = weight;
+    }
+
+    /// Accumulator of count points whose deviations from (shift_x, shift_y) have the given sums
+    /// Sums of deviations from a point close to the mean lose little to cancellation and vectorize well
+    static regression_accumulator from_shifted_sums(uint64_t count, double shift_x, double shift_y,
+                                                    double sum_dx, double sum_dy, double sum_dx2, double sum_dxdy){
+        regression_accumulator result;
+        if(count == 0){
+            return result;
+        }
+        result.m_weight = static_cast<double>(count);
+        result.m_shift_x = shift_x;
+        result.m_shift_y = shift_y;
+        result.m_mean_x = sum_dx / count;
+        result.m_mean_y = sum_dy / count;
+        result.m_m2_x = sum_dx2 - sum_dx * sum_dx / count;
+        result.m_c_xy = sum_dxdy - sum_dx * sum_dy / count;
+        return result;
+    }
+
+    /// Sum of weights of all points, their number if none was weighted or decayed
+    double weight() const {
+        return m_weight;
+    }
+
+    /// Fitted line, slope is not finite if there are fewer than two distinct x
+    line result() const {
+        auto slope = m_c_xy / m_m2_x;
+        return {m_shift_y + m_mean_y - slope * (m_shift_x + m_mean_x), slope};
+    }
+
+private:
+    double m_weight = 0;
+    /// First point added, means below are of deviations from it
+    double m_shift_x = 0;
+    double m_shift_y = 0;
+    double m_mean_x = 0;
+    double m_mean_y = 0;
+    /// Weighted sum of (x - mean x)^2
+    double m_m2_x = 0;
+    /// Weighted sum of (x - mean x)(y - mean y)
+    double m_c_xy = 0;
+};
+
+#endif //COMPETITION3_REGRESSION_HH
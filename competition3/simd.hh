@@ -0,0 +1,31 @@
+#ifndef COMPETITION3_SIMD_HH
+#define COMPETITION3_SIMD_HH
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REGRESSION_X86_KERNELS 1
+#endif
+
+namespace regression_detail {
+
+enum class simd { scalar, avx2_fma };
+
+inline simd detect_simd(){
+#ifdef REGRESSION_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+        return simd::avx2_fma;
+    }
+#endif
+    return simd::scalar;
+}
+
+/// Kernels used by all reductions, tests lower it to check the scalar ones
+inline simd& active_simd(){
+    static simd level = detect_simd();
+    return level;
+}
+
+}
+
+#endif //COMPETITION3_SIMD_HH
@@ -0,0 +1,232 @@
+#include "least_squares.hh"
+#include "parallel_regression.hh"
+#include "regression.hh"
+#include "window_regression.hh"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/// Tests of the fits, asserts have to stay enabled
+/// Build with: c++ -std=c++17 -O2 -pthread test.cc
+
+struct points {
+    std::vector<double> xs;
+    std::vector<double> ys;
+};
+
+/// Intercept and slope by two passes in long double, a reference for the accumulators
+line exact_fit(const points& data){
+    long double mean_x = 0, mean_y = 0;
+    for(std::size_t index = 0; index < data.xs.size(); ++index){
+        mean_x += data.xs[index];
+        mean_y += data.ys[index];
+    }
+    mean_x /= data.xs.size();
+    mean_y /= data.xs.size();
+    long double m2_x = 0, c_xy = 0;
+    for(std::size_t index = 0; index < data.xs.size(); ++index){
+        m2_x += (data.xs[index] - mean_x) * (data.xs[index] - mean_x);
+        c_xy += (data.xs[index] - mean_x) * (data.ys[index] - mean_y);
+    }
+    auto slope = c_xy / m2_x;
+    return {static_cast<double>(mean_y - slope * mean_x), static_cast<double>(slope)};
+}
+
+std::string to_text(const points& data){
+    std::string result;
+    char buffer[64];
+    for(std::size_t index = 0; index < data.xs.size(); ++index){
+        std::snprintf(buffer, sizeof(buffer), "%.17g %.17g\n", data.xs[index], data.ys[index]);
+        result += buffer;
+    }
+    return result;
+}
+
+/// Sorted x far from zero, the intercept is extrapolated 1e9 away from the data and shows any drift of the means
+void test_large_sorted_x(){
+    std::mt19937_64 rng{1};
+    std::normal_distribution<double> noise;
+    points data;
+    for(int index = 0; index < 300000; ++index){
+        auto x = 1e9 + 0.01 * index;
+        data.xs.push_back(x);
+        data.ys.push_back(0.5 * x + 3 + noise(rng));
+    }
+    auto exact = exact_fit(data);
+
+    regression_accumulator sequential;
+    regression_accumulator first_half, second_half;
+    for(std::size_t index = 0; index < data.xs.size(); ++index){
+        sequential.add(data.xs[index], data.ys[index]);
+        (index < data.xs.size() / 2 ? first_half : second_half).add(data.xs[index], data.ys[index]);
+    }
+    first_half.merge(second_half);
+    auto text = to_text(data);
+    auto parallel = fit_parallel(text.data(), text.size(), 4);
+
+    for(auto& fit: {sequential, first_half, parallel}){
+        auto [intercept, slope] = fit.result();
+        assert(std::abs(intercept - exact.intercept) < 1e-2);
+        assert(std::abs(slope - exact.slope) < 1e-11);
+    }
+    auto sequential_intercept = sequential.result().intercept;
+    auto parallel_intercept = parallel.result().intercept;
+    assert(std::abs(sequential_intercept - parallel_intercept) < 1e-2);
+}
+
+/// Removing points and merging parts leaves the same fit as adding only the rest
+void test_remove_and_merge(){
+    std::mt19937_64 rng{2};
+    std::uniform_real_distribution<double> uniform{-1e3, 1e3};
+    regression_accumulator all, kept, part;
+    std::vector<std::pair<double, double>> removed;
+    for(int index = 0; index < 1000; ++index){
+        auto x = 5e6 + uniform(rng);
+        auto y = -2 * x + uniform(rng);
+        all.add(x, y);
+        if(index % 3 == 0){
+            removed.emplace_back(x, y);
+        }
+        else{
+            (index < 500 ? kept : part).add(x, y);
+        }
+    }
+    for(auto [x, y]: removed){
+        all.remove(x, y);
+    }
+    kept.merge(part);
+    assert(all.weight() == kept.weight());
+    auto [intercept, slope] = all.result();
+    auto [kept_intercept, kept_slope] = kept.result();
+    assert(std::abs(slope - kept_slope) < 1e-9);
+    assert(std::abs(intercept - kept_intercept) < 1e-2);
+}
+
+/// Exact rows of a known plane with regressors around 1e6, then the same with one regressor a sum of the others
+void test_least_squares(){
+    std::mt19937_64 rng{3};
+    std::uniform_real_distribution<double> uniform{-10, 10};
+    const std::vector<double> coefficients{2, 1.5, -0.25, 3};
+    least_squares fit{3}, dependent{3}, short_fit{3};
+    for(int row = 0; row < 1000; ++row){
+        double x[3];
+        auto y = coefficients[0];
+        for(int column = 0; column < 3; ++column){
+            x[column] = 1e6 * (column + 1) + uniform(rng);
+            y += coefficients[column + 1] * x[column];
+        }
+        fit.add(x, y);
+        if(row < 3){
+            short_fit.add(x, y);
+        }
+        x[2] = x[0] + x[1];
+        dependent.add(x, y);
+    }
+    assert(fit.count() == 1000);
+
+    auto result = fit.result();
+    assert(result.size() == 4);
+    assert(std::abs(result[0] - coefficients[0]) < 1e-3);
+    for(std::size_t index = 1; index < 4; ++index){
+        assert(std::abs(result[index] - coefficients[index]) < 1e-9);
+    }
+    for(auto coefficient: dependent.result()){
+        assert(std::isnan(coefficient));
+    }
+    // Fewer rows than coefficients don't determine them
+    for(auto coefficient: short_fit.result()){
+        assert(std::isnan(coefficient));
+    }
+}
+
+/// Weighted fit by two passes in long double, point i weighs decay^(number of points after it)
+line exact_weighted_fit(const std::vector<std::pair<double, double>>& points, double decay){
+    long double weight = 0, mean_x = 0, mean_y = 0, point_weight = 1;
+    for(auto index = points.size(); index-- > 0; point_weight *= decay){
+        weight += point_weight;
+        mean_x += point_weight * points[index].first;
+        mean_y += point_weight * points[index].second;
+    }
+    mean_x /= weight;
+    mean_y /= weight;
+    long double m2_x = 0, c_xy = 0;
+    point_weight = 1;
+    for(auto index = points.size(); index-- > 0; point_weight *= decay){
+        m2_x += point_weight * (points[index].first - mean_x) * (points[index].first - mean_x);
+        c_xy += point_weight * (points[index].first - mean_x) * (points[index].second - mean_y);
+    }
+    auto slope = c_xy / m2_x;
+    return {static_cast<double>(mean_y - slope * mean_x), static_cast<double>(slope)};
+}
+
+/// Window fit after every point against a fit of the last points from scratch, over many wraparounds of the ring
+/// Window of size 0 keeps every point, its fit only decays
+void test_window(){
+    std::mt19937_64 rng{4};
+    std::uniform_real_distribution<double> uniform{-1, 1};
+    for(std::size_t size: {0, 1, 2, 7}){
+        for(double decay: {1.0, 0.9}){
+            if(size == 0 && decay == 1){
+                continue;
+            }
+            window_regression fit{size, decay};
+            std::vector<std::pair<double, double>> points;
+            for(int index = 0; index < 200; ++index){
+                auto x = 1e4 + index + 10 * uniform(rng);
+                auto y = 3 * x - 5 + uniform(rng);
+                points.emplace_back(x, y);
+                fit.add(x, y);
+
+                auto first = size && points.size() > size ? points.end() - size : points.begin();
+                auto exact = exact_weighted_fit({first, points.end()}, decay);
+                auto [intercept, slope] = fit.result();
+                // One point in the window has no slope, removals must not leave a made-up one behind
+                if(!std::isfinite(exact.slope)){
+                    assert(!std::isfinite(slope));
+                    continue;
+                }
+                assert(std::abs(slope - exact.slope) < 1e-9 * std::abs(exact.slope));
+                assert(std::abs(intercept - exact.intercept) < 1e-4);
+            }
+        }
+    }
+
+    // Results are reported after every k pairs, a partial group at the end reports nothing
+    std::vector<double> values;
+    for(int index = 0; index < 2 * 23; ++index){
+        values.push_back(index % 2 ? index * index : index);
+    }
+    for(uint64_t every: {1, 5, 23, 24}){
+        window_regression fit{4};
+        auto next = values.begin();
+        std::size_t reports = 0;
+        auto points = report_every(fit, every, [&](double& value){
+            if(next == values.end()){
+                return false;
+            }
+            value = *next++;
+            return true;
+        }, [&](line){ ++reports; });
+        assert(points == 23);
+        assert(reports == 23 / every);
+    }
+}
+
+int main(){
+    using regression_detail::simd;
+    // Every test runs on the scalar kernels and on the ones detected for this CPU
+    auto detected = regression_detail::active_simd();
+    for(auto level: {simd::scalar, detected}){
+        regression_detail::active_simd() = level;
+        test_large_sorted_x();
+        test_remove_and_merge();
+        test_least_squares();
+        test_window();
+    }
+    std::cout << "ok" << std::endl;
+}
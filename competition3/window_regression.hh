@@ -0,0 +1,87 @@
+#ifndef COMPETITION3_WINDOW_REGRESSION_HH
+#define COMPETITION3_WINDOW_REGRESSION_HH
+
+#include "regression.hh"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// Fit over the last points of a stream, each point added and the oldest one removed in constant time
+/// Optionally every point's weight is multiplied by decay whenever a newer one arrives (exponential forgetting)
+/// Removals leave rounding errors behind, so the fit is rebuilt from the window each time it is filled anew,
+/// which costs O(1) per point on average
+class window_regression {
+public:
+    /// Window of size 0 keeps all points, which makes sense only with decay below 1
+    explicit window_regression(std::size_t size, double decay = 1) : m_size{size}, m_decay{decay} {
+        m_points.reserve(size);
+        if(size){
+            m_oldest_weight = std::pow(decay, static_cast<double>(size - 1));
+        }
+    }
+
+    void add(double x, double y){
+        m_fit.decay(m_decay);
+        if(m_size == 0){
+            m_fit.add(x, y);
+            return;
+        }
+        if(m_points.size() < m_size){
+            m_points.emplace_back(x, y);
+            m_fit.add(x, y);
+            return;
+        }
+
+        // Oldest point has been decayed once for each point which came after it, and once more just now
+        auto [old_x, old_y] = m_points[m_oldest];
+        m_fit.remove(old_x, old_y, m_oldest_weight * m_decay);
+        m_fit.add(x, y);
+        m_points[m_oldest] = {x, y};
+        if(++m_oldest == m_size){
+            m_oldest = 0;
+            rebuild();
+        }
+    }
+
+    line result() const {
+        return m_fit.result();
+    }
+
+private:
+    std::size_t m_size;
+    double m_decay;
+    /// Weight of oldest point in a full window
+    double m_oldest_weight = 1;
+    /// Ring of the points in window, m_oldest is the next one to leave
+    std::vector<std::pair<double, double>> m_points;
+    std::size_t m_oldest = 0;
+    regression_accumulator m_fit;
+
+    void rebuild(){
+        m_fit = {};
+        for(auto index = m_oldest; index < m_oldest + m_size; ++index){
+            auto [x, y] = m_points[index % m_size];
+            m_fit.decay(m_decay);
+            m_fit.add(x, y);
+        }
+    }
+};
+
+/// Feeds pairs x y from next(value), which returns false at end of input, into fit and calls report(line)
+/// after every k pairs, returns the number of pairs
+template<typename Next, typename Report>
+uint64_t report_every(window_regression& fit, uint64_t every, Next next, Report report){
+    uint64_t points = 0;
+    for(double x, y; next(x) && next(y);){
+        fit.add(x, y);
+        if(++points % every == 0){
+            report(fit.result());
+        }
+    }
+    return points;
+}
+
+#endif //COMPETITION3_WINDOW_REGRESSION_HH
@@ -0,0 +1,134 @@
+/// Part of PB173 homework, created by Ondřej Budai <ondrej@budai.cz>
+
+#ifndef HW2_BENCH_COMMON_HH
+#define HW2_BENCH_COMMON_HH
+
+#include "hash_set_linked_list.hh"
+#include "hash_set_linear_probing.hh"
+#include "hash_set_string_arena.hh"
+#include "prefiltered_set.hh"
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/// Shared pieces of the hash set benchmarks: deterministic key streams and list of compared sets
+namespace bench {
+
+constexpr int64_t MIN_ITEMS = 1000;
+constexpr int64_t MAX_INT_ITEMS = 100000000;
+/// 100M strings of 64 chars don't fit into memory of a usual machine
+constexpr int64_t MAX_STRING_ITEMS = 10000000;
+constexpr size_t STRING_LENGTH = 64;
+/// Number of lookups done by every find benchmark, independent of the set size
+constexpr size_t LOOKUPS = 1 << 20;
+
+/// Bijection on 32-bit numbers (finalizer of MurmurHash3), so distinct ids give distinct keys
+constexpr uint32_t mix(uint32_t x){
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+template<typename Key> Key make_key(uint32_t id);
+
+template<> inline int make_key<int>(uint32_t id){
+    return static_cast<int>(mix(id));
+}
+
+/// String starts with hex representation of mixed id, so keys are unique and differ early
+/// like real-world keys usually do, the rest is filled with pseudorandom characters
+template<> inline std::string make_key<std::string>(uint32_t id){
+    static const char VALID_CHARS[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    std::string key(STRING_LENGTH, ' ');
+    auto mixed = mix(id);
+    for(size_t i = 0; i < 8; ++i){
+        key[i] = "0123456789abcdef"[(mixed >> (4 * i)) & 0xf];
+    }
+    std::minstd_rand random_engine{id + 1};
+    for(size_t i = 8; i < STRING_LENGTH; ++i){
+        key[i] = VALID_CHARS[random_engine() % (sizeof(VALID_CHARS) - 1)];
+    }
+    return key;
+}
+
+/// Keys which are inserted into the set, even ids are used for them
+template<typename Key> std::vector<Key> make_inserted_keys(size_t count){
+    std::vector<Key> keys;
+    keys.reserve(count);
+    for(size_t i = 0; i < count; ++i){
+        keys.emplace_back(make_key<Key>(static_cast<uint32_t>(2 * i)));
+    }
+    return keys;
+}
+
+/// Stream of lookups, hit_percent of them are inserted keys, the rest uses odd ids so it misses
+/// Same seed gives the same stream, so every implementation searches for the same keys
+template<typename Key> std::vector<Key> make_lookup_keys(const std::vector<Key>& inserted, size_t count, int hit_percent){
+    std::mt19937_64 random_engine{42};
+    std::uniform_int_distribution<size_t> pick_inserted(0, inserted.size() - 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    std::vector<Key> keys;
+    keys.reserve(count);
+    for(size_t i = 0; i < count; ++i){
+        if(percent(random_engine) < hit_percent){
+            keys.emplace_back(inserted[pick_inserted(random_engine)]);
+        }
+        else{
+            keys.emplace_back(make_key<Key>(static_cast<uint32_t>(2 * i + 1)));
+        }
+    }
+    return keys;
+}
+
+/// Compared implementations, in order of y axis of the benchmarks
+template<typename Key> struct implementations {
+    using sets = std::tuple<hash_set_linked_list<Key>, hash_set_linear_probing<Key>, std::unordered_set<Key>, std::set<Key>,
+                            prefiltered_set<Key>>;
+    static constexpr std::array<const char*, 5> names = {"linked list", "linear probing", "std::unordered_set", "std::set",
+                                                         "linear probing+bloom"};
+};
+
+template<> struct implementations<std::string> {
+    using sets = std::tuple<hash_set_linked_list<std::string>, hash_set_linear_probing<std::string>,
+                            std::unordered_set<std::string>, std::set<std::string>, prefiltered_set<std::string>,
+                            hash_set_string_arena, prefiltered_set<std::string, hash_set_string_arena>>;
+    static constexpr std::array<const char*, 7> names = {"linked list", "linear probing", "std::unordered_set", "std::set",
+                                                         "linear probing+bloom", "string arena", "string arena+bloom"};
+};
+
+template<typename Tuple, typename Function, size_t ... Indices>
+void visit_at(Tuple& tuple, size_t index, Function&& function, std::index_sequence<Indices ...>){
+    ((Indices == index ? function(std::get<Indices>(tuple)) : void()), ...);
+}
+
+/// Calls function with index-th element of tuple, index is known only at runtime
+template<typename Tuple, typename Function>
+void visit_at(Tuple& tuple, size_t index, Function&& function){
+    visit_at(tuple, index, function, std::make_index_sequence<std::tuple_size_v<Tuple>>{});
+}
+
+/// Our sets return bool from find, standard ones return iterator
+template<typename Set, typename Key> bool contains(const Set& set, const Key& key){
+    if constexpr (std::is_same_v<decltype(set.find(key)), bool>){
+        return set.find(key);
+    }
+    else{
+        return set.find(key) != set.end();
+    }
+}
+
+}
+
+#endif //HW2_BENCH_COMMON_HH
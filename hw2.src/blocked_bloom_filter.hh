@@ -0,0 +1,139 @@
+/// Part of PB173 homework, created by Ondřej Budai <ondrej@budai.cz>
+
+#ifndef HW2_BLOCKED_BLOOM_FILTER_HH
+#define HW2_BLOCKED_BLOOM_FILTER_HH
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HW2_X86_KERNELS 1
+#endif
+
+/// Blocked Bloom filter, each item sets one bit in each of 16 lanes of a single 64 byte block,
+/// so every query touches exactly one cache line
+/// Filter only answers "maybe present" or "certainly not present" and items can't be removed
+/// Lanes are probed with AVX2 if the CPU has it, picked at runtime so no -march flag is needed
+class blocked_bloom_filter {
+public:
+    enum class simd { scalar, avx2 };
+
+    static simd detect_simd(){
+#ifdef HW2_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            return simd::avx2;
+        }
+#endif
+        return simd::scalar;
+    }
+
+    /// Kernels used by all filters, tests may lower it to check the scalar ones
+    static simd& active_simd(){
+        static simd level = detect_simd();
+        return level;
+    }
+
+    static constexpr size_t LANES = 16;
+    /// Roughly 16 bits per item, gives false positive rate around 0.1 %
+    static constexpr size_t ITEMS_PER_BLOCK = 32;
+
+    explicit blocked_bloom_filter(size_t expected_items){
+        size_t block_count = 1;
+        while(block_count * ITEMS_PER_BLOCK < expected_items){
+            block_count *= 2;
+        }
+        m_blocks.assign(block_count, block{});
+    }
+
+    /// Adds item with given (well mixed) 64-bit hash
+    void add(uint64_t hash){
+        auto& target = m_blocks[block_index(hash)];
+        auto key = static_cast<uint32_t>(hash);
+#ifdef HW2_X86_KERNELS
+        if(active_simd() == simd::avx2){
+            add_avx2(target, key);
+            return;
+        }
+#endif
+        for(size_t i = 0; i < LANES; ++i){
+            target.lanes[i] |= lane_bit(key, i);
+        }
+    }
+
+    /// Returns false only if item with given hash was certainly never added
+    bool may_contain(uint64_t hash) const {
+        const auto& target = m_blocks[block_index(hash)];
+        auto key = static_cast<uint32_t>(hash);
+#ifdef HW2_X86_KERNELS
+        if(active_simd() == simd::avx2){
+            return may_contain_avx2(target, key);
+        }
+#endif
+        uint32_t missing = 0;
+        for(size_t i = 0; i < LANES; ++i){
+            missing |= ~target.lanes[i] & lane_bit(key, i);
+        }
+        return missing == 0;
+    }
+
+    /// Size of the filter in bytes
+    size_t memory_size() const {
+        return m_blocks.size() * sizeof(block);
+    }
+
+private:
+    struct alignas(64) block {
+        uint32_t lanes[LANES] = {};
+    };
+
+    /// Odd multipliers, each lane picks its bit from a different multiplicative hash of the key
+    static constexpr uint32_t SALT[LANES] = {
+        0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du, 0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u,
+        0x1e3f5a97u, 0xc3a5c85bu, 0x27d4eb2fu, 0x85ebca77u, 0x9e3779b1u, 0x61c88647u, 0xb5297a4du, 0x68e31da5u,
+    };
+
+    std::vector<block> m_blocks;
+
+    /// Upper half of hash picks the block, lower half the bits inside of it
+    size_t block_index(uint64_t hash) const {
+        return (hash >> 32) & (m_blocks.size() - 1);
+    }
+
+    static uint32_t lane_bit(uint32_t key, size_t lane){
+        return uint32_t{1} << ((key * SALT[lane]) >> 27);
+    }
+
+#ifdef HW2_X86_KERNELS
+    __attribute__((target("avx2")))
+    static __m256i make_mask(uint32_t key, size_t first_lane){
+        auto salt = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&SALT[first_lane]));
+        auto shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(key)), salt), 27);
+        return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+    }
+
+    __attribute__((target("avx2")))
+    static void add_avx2(block& target, uint32_t key){
+        for(size_t half = 0; half < LANES; half += 8){
+            auto lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(&target.lanes[half]));
+            lanes = _mm256_or_si256(lanes, make_mask(key, half));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(&target.lanes[half]), lanes);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static bool may_contain_avx2(const block& target, uint32_t key){
+        for(size_t half = 0; half < LANES; half += 8){
+            auto lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(&target.lanes[half]));
+            // testc returns 1 if all bits of mask are set in lanes
+            if(!_mm256_testc_si256(lanes, make_mask(key, half))){
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+};
+
+#endif //HW2_BLOCKED_BLOOM_FILTER_HH
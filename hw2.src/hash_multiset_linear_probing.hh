@@ -0,0 +1,169 @@
+/// Part of PB173 homework, created by Ondřej Budai <ondrej@budai.cz>
+
+#ifndef HW2_HASH_MULTISET_LINEAR_PROBING_HH
+#define HW2_HASH_MULTISET_LINEAR_PROBING_HH
+
+#include "hash_set_linear_probing.hh"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// Multiset (hash set with occurrence counts) on top of the table of hash_set_linear_probing
+/// Every field has one byte counter next to the table, counts which don't fit into it are spilled
+/// to a side table of wide counters
+template<typename T, typename Allocator = std::allocator<T>> class hash_multiset_linear_probing {
+    using table = linear_probing_table<T, Allocator>;
+public:
+
+    hash_multiset_linear_probing() : hash_multiset_linear_probing(Allocator()){}
+
+    explicit hash_multiset_linear_probing(const Allocator& allocator)
+        : m_allocator{allocator}, m_table{INITIAL_HASH_TABLE_SIZE, m_allocator}, m_counters(INITIAL_HASH_TABLE_SIZE) {}
+
+    hash_multiset_linear_probing(const hash_multiset_linear_probing&) = delete;
+    hash_multiset_linear_probing& operator=(const hash_multiset_linear_probing&) = delete;
+
+    /// Adds item `by` times, count of an item stops at UINT64_MAX
+    void increment(const T& item, uint64_t by = 1){
+        if(by == 0){
+            return;
+        }
+        auto [found, index] = m_table.insert_at(item);
+        if(found){
+            add_to_counter(index, by);
+            return;
+        }
+        m_counters[index] = 0;
+        add_to_counter(index, by);
+        // Same growth policy as hash_set_linear_probing, deleted fields count as used
+        if(m_table.used_count() > MAX_LOAD * m_table.size()){
+            auto grow = m_table.element_count() > MAX_LOAD / 2 * m_table.size();
+            resize(grow ? 2 * m_table.size() : m_table.size());
+        }
+    }
+
+    /// Adds item once, so the multiset can be used where a set is expected
+    void insert(const T& item){
+        increment(item);
+    }
+
+    /// Removes `by` occurrences of item, or all of them if there are fewer
+    /// Returns number of removed occurrences
+    uint64_t decrement(const T& item, uint64_t by = 1){
+        auto [found, index] = m_table.find_item_index(item);
+        if(!found || by == 0){
+            return 0;
+        }
+        auto count = counter_at(index);
+        if(by >= count){
+            m_table.erase_index(index);
+            m_overflow.erase(index);
+            return count;
+        }
+        set_counter(index, count - by);
+        return by;
+    }
+
+    /// Removes all occurrences of item, returns their number
+    uint64_t erase(const T& item){
+        return decrement(item, UINT64_MAX);
+    }
+
+    /// Number of occurrences of item, zero if it isn't present
+    uint64_t count(const T& item) const {
+        auto [found, index] = m_table.find_item_index(item);
+        return found ? counter_at(index) : 0;
+    }
+
+    bool find(const T& item) const {
+        return m_table.find(item);
+    }
+
+    /// Adds all occurrences of all items of other multiset
+    /// Reserves room for both operands up front, deleted fields may still make the table rehash during the merge
+    void merge(const hash_multiset_linear_probing& other){
+        reserve(size() + other.size());
+        other.for_each([this](const T& item, uint64_t count){
+            increment(item, count);
+        });
+    }
+
+    /// Makes sure that count distinct items fit without growing the table
+    void reserve(size_t count){
+        auto new_size = m_table.size();
+        while(count > MAX_LOAD * new_size){
+            new_size *= 2;
+        }
+        if(new_size != m_table.size()){
+            resize(new_size);
+        }
+    }
+
+    /// Number of distinct items
+    size_t size() const {
+        return m_table.element_count();
+    }
+
+    /// Calls function(item, count) for every distinct item
+    template<typename Function> void for_each(Function function) const {
+        for(auto i = m_table.next_assigned(0); i < m_table.size(); i = m_table.next_assigned(i + 1)){
+            function(m_table.at(i), counter_at(i));
+        }
+    }
+
+private:
+    static constexpr size_t INITIAL_HASH_TABLE_SIZE = 1024;
+    static constexpr float MAX_LOAD = 0.7f;
+    /// Counter value saying the real count is in m_overflow
+    static constexpr uint8_t COUNTER_OVERFLOW = UINT8_MAX;
+
+    Allocator m_allocator;
+    table m_table;
+    /// Counter of every field, meaningful only for assigned ones
+    std::vector<uint8_t> m_counters;
+    /// Wide counters of fields whose count doesn't fit into a byte, keyed by field index
+    std::unordered_map<size_t, uint64_t> m_overflow;
+
+    uint64_t counter_at(size_t index) const {
+        if(m_counters[index] != COUNTER_OVERFLOW){
+            return m_counters[index];
+        }
+        return m_overflow.at(index);
+    }
+
+    void set_counter(size_t index, uint64_t count){
+        if(count < COUNTER_OVERFLOW){
+            m_counters[index] = static_cast<uint8_t>(count);
+            m_overflow.erase(index);
+        }
+        else{
+            m_counters[index] = COUNTER_OVERFLOW;
+            m_overflow[index] = count;
+        }
+    }
+
+    /// Counts saturate at UINT64_MAX instead of wrapping around
+    void add_to_counter(size_t index, uint64_t by){
+        auto count = counter_at(index);
+        set_counter(index, by > UINT64_MAX - count ? UINT64_MAX : count + by);
+    }
+
+    /// Moves all items into a table of given size, counters move with their items
+    void resize(size_t new_size){
+        std::vector<uint8_t> counters(new_size);
+        std::unordered_map<size_t, uint64_t> overflow;
+        m_table = m_table.create_resized_self(new_size, [&](size_t from, size_t to){
+            counters[to] = m_counters[from];
+            if(m_counters[from] == COUNTER_OVERFLOW){
+                overflow[to] = m_overflow.at(from);
+            }
+        });
+        m_counters = std::move(counters);
+        m_overflow = std::move(overflow);
+    }
+};
+
+#endif //HW2_HASH_MULTISET_LINEAR_PROBING_HH
@@ -3,206 +3,393 @@
 #ifndef HW1_HASH_LINEAR_PROBING_HH
 #define HW1_HASH_LINEAR_PROBING_HH
 
+#include <cstdint>
 #include <functional>
+#include <iterator>
 #include <vector>
 #include <memory>
 
-/// Hash set implemented using linear probing
-template<typename T, typename Allocator = std::allocator<T>> class hash_set_linear_probing {
-public:
-
-    hash_set_linear_probing() : hash_set_linear_probing(Allocator()){}
+enum class field_state {
+    FREE, ASSIGNED, DELETED
+};
 
-    explicit hash_set_linear_probing(const Allocator& allocator) : m_allocator{allocator}, m_impl{INITIAL_HASH_TABLE_SIZE, m_allocator} {}
+/// Keeps states of fields as two bitmaps, so assigned fields can be found a word at a time
+class state_vector {
+public:
+    explicit state_vector(size_t num_fields) : m_num_fields{num_fields} {
+        m_assigned.assign((num_fields + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+        m_deleted.assign(m_assigned.size(), 0);
+    }
 
-    /// Insert item into set
-    void insert(const T& item){
-        bool actually_inserted = m_impl.insert(item);
-        if(!actually_inserted){
-            return;
+    void set_state(size_t field_num, field_state new_state){
+        auto word = field_num / BITS_PER_WORD;
+        auto bit = uint64_t{1} << (field_num % BITS_PER_WORD);
+        m_assigned[word] &= ~bit;
+        m_deleted[word] &= ~bit;
+        if(new_state == field_state::ASSIGNED){
+            m_assigned[word] |= bit;
         }
-        ++m_num_elements;
-        // If number elements grows sufficiently, grow the bucket count
-        // Please note without resizing the implementation will break!
-        if(m_num_elements > MAX_LOAD * m_impl.size()){
-            m_impl = m_impl.create_bigger_self();
+        if(new_state == field_state::DELETED){
+            m_deleted[word] |= bit;
         }
     }
 
-    /// Searches for item in set
-    bool find(const T& item) const{
-        return m_impl.find(item);
+    field_state get_state(size_t field_num) const {
+        auto word = field_num / BITS_PER_WORD;
+        auto bit = uint64_t{1} << (field_num % BITS_PER_WORD);
+        if(m_assigned[word] & bit){
+            return field_state::ASSIGNED;
+        }
+        if(m_deleted[word] & bit){
+            return field_state::DELETED;
+        }
+        return field_state::FREE;
     }
 
-    void erase(const T& item){
-        m_impl.erase(item);
+    /// Returns index of the first assigned field at or after field_num,
+    /// or number of fields if there is no such field
+    size_t next_assigned(size_t field_num) const {
+        if(field_num >= m_num_fields){
+            return m_num_fields;
+        }
+        auto word = field_num / BITS_PER_WORD;
+        // Mask out fields before field_num in the first word
+        auto bits = m_assigned[word] & (~uint64_t{0} << (field_num % BITS_PER_WORD));
+        while(bits == 0){
+            ++word;
+            if(word >= m_assigned.size()){
+                return m_num_fields;
+            }
+            bits = m_assigned[word];
+        }
+        return word * BITS_PER_WORD + __builtin_ctzll(bits);
     }
 
 private:
-    class impl;
-    Allocator m_allocator;
-    impl m_impl;
-    static constexpr size_t INITIAL_HASH_TABLE_SIZE = 1024;
-    size_t m_num_elements = 0;
-    static constexpr float MAX_LOAD = 0.7f;
+    static constexpr size_t BITS_PER_WORD = 64;
+    size_t m_num_fields;
+    std::vector<uint64_t> m_assigned;
+    std::vector<uint64_t> m_deleted;
+};
 
-    enum class field_state {
-        FREE, ASSIGNED, DELETED
+/// Table of items with linear probing, shared by hash_set_linear_probing and hash_multiset_linear_probing
+/// Callers decide when to grow it, create_resized_self tells them where every item moved
+/// so data kept alongside fields can follow its item
+template<typename T, typename Allocator> class linear_probing_table {
+public:
+    struct item_index_search_result {
+        bool found;
+        size_t index;
     };
 
-    class state_vector {
-    public:
-        explicit state_vector(size_t num_fields){
-            m_data.assign(num_fields * 2, false);
+    linear_probing_table(size_t initial_size, Allocator& allocator) : m_hash_table_size{initial_size}, m_field_states{initial_size}, m_allocator{allocator} {
+        m_hash_table = {allocator.allocate(initial_size),
+                        [&allocator, initial_size](T* p) mutable {
+                            allocator.deallocate(p, initial_size);
+                        }
+        };
+    }
+
+    /// Copies fields one by one, so the copy has the same layout as the original
+    linear_probing_table(const linear_probing_table& other, Allocator& allocator) : linear_probing_table(other.m_hash_table_size, allocator) {
+        m_field_states = other.m_field_states;
+        m_num_elements = other.m_num_elements;
+        m_num_used = other.m_num_used;
+        for(auto i = other.next_assigned(0); i < m_hash_table_size; i = other.next_assigned(i + 1)){
+            new (&m_hash_table.get()[i]) T(other.m_hash_table.get()[i]);
         }
+    }
 
-        void set_state(size_t field_num, field_state new_state){
-            auto new_state_int = static_cast<int>(new_state);
-            m_data[field_num * 2] = (new_state_int & 1) == 1;
-            m_data[field_num * 2 + 1] = (new_state_int & 2) == 2;
+    linear_probing_table(linear_probing_table&) = delete;
+    linear_probing_table& operator=(linear_probing_table&) = delete;
+    linear_probing_table(linear_probing_table&&) noexcept = default;
+    linear_probing_table& operator=(linear_probing_table&& other) noexcept {
+        this->~linear_probing_table();
+        new (this) linear_probing_table(std::move(other));
+        return *this;
+    }
+
+    ~linear_probing_table(){
+        if(!m_hash_table){
+            return;
         }
+        for(auto i = next_assigned(0); i < m_hash_table_size; i = next_assigned(i + 1)){
+            m_hash_table.get()[i].~T();
+        }
+    }
+
+    bool insert(const T& item){
+        return !insert_at(item).found;
+    }
 
-        field_state get_state(size_t field_num) const {
-            auto lower_bit = static_cast<int>(m_data[field_num * 2]);
-            auto higher_bit = static_cast<int>(m_data[field_num * 2 + 1]);
-            auto field_state_int = lower_bit | higher_bit << 1;
+    /// Inserts item unless it is present
+    /// Returns whether it was present and index of its field either way
+    item_index_search_result insert_at(const T& item){
+        const auto index = get_first_possible_index(item);
 
-            return static_cast<field_state>(field_state_int);
+        auto result = find_next_free_index(item, index);
+        if(!result.found){
+            insert_to_index(item, result.index);
         }
+        return result;
+    }
 
-    private:
-        std::vector<bool> m_data;
-    };
+    bool find(const T& item) const {
+        return find_item_index(item).found;
+    }
 
-    /// Helping class allowing us to nicely implement hash set growth
-    class impl {
-    public:
-        impl(size_t initial_size, Allocator& allocator) : m_hash_table_size{initial_size}, m_field_states{initial_size}, m_allocator{allocator} {
-            m_hash_table = {allocator.allocate(initial_size),
-                            [&allocator, initial_size](T* p) mutable {
-                                allocator.deallocate(p, initial_size);
-                            }
-            };
-        }
-
-        impl(impl&) = delete;
-        impl& operator=(impl&) = delete;
-        impl(impl&&) noexcept = default;
-        impl& operator=(impl&& other) noexcept {
-            this->~impl();
-            new (this) impl(std::move(other));
-            return *this;
+    void erase(const T& item){
+        auto [found, index] = find_item_index(item);
+        if (!found){
+            return;
         }
 
-        ~impl(){
-            if(!m_hash_table){
-                return;
-            }
-            for(size_t i = 0; i < m_hash_table_size; ++i){
-                if(m_field_states.get_state(i) != field_state::ASSIGNED){
-                    continue;
-                }
-                m_hash_table.get()[i].~T();
+        erase_index(index);
+    }
+
+    template<typename Predicate> size_t erase_if(Predicate& predicate){
+        size_t erased = 0;
+        for(auto i = next_assigned(0); i < m_hash_table_size; i = next_assigned(i + 1)){
+            if(predicate(static_cast<const T&>(m_hash_table.get()[i]))){
+                erase_index(i);
+                ++erased;
             }
         }
+        return erased;
+    }
 
-        bool insert(const T& item){
-            const auto index = get_first_possible_index(item);
+    /// Removes item in field index, the field stays deleted until the table is resized
+    void erase_index(size_t index){
+        m_field_states.set_state(index, field_state::DELETED);
+        m_hash_table.get()[index].~T();
+        --m_num_elements;
+    }
 
-            auto [found, free_index] = find_next_free_index(item, index);
-            if(found){
-                return false;
+    /// Return true, index of the item if it was found
+    /// Return false, 0 otherwise
+    item_index_search_result find_item_index(const T& item) const {
+        auto index = get_first_possible_index(item);
+        while(true){
+            const auto field_state = m_field_states.get_state(index);
+            if(field_state == field_state::FREE){
+                return {false, 0};
+            }
+            if(field_state == field_state::ASSIGNED && m_hash_table.get()[index] == item){
+                return {true, index};
+            }
+            ++index;
+            if(index >= m_hash_table_size){
+                index = 0;
             }
-            insert_to_index(item, free_index);
-            return true;
         }
+    }
+
+    /// Creates table with same items but table of given size
+    linear_probing_table create_resized_self(size_t new_size){
+        return create_resized_self(new_size, [](size_t, size_t){});
+    }
 
-        bool find(const T& item) const {
-            return find_item_index(item).found;
+    /// Same as above, calls moved(old index, new index) for every item
+    template<typename Moved> linear_probing_table create_resized_self(size_t new_size, Moved moved){
+        linear_probing_table new_impl{new_size, m_allocator};
+
+        for(auto i = next_assigned(0); i < m_hash_table_size; i = next_assigned(i + 1)){
+            moved(i, new_impl.insert_at(m_hash_table.get()[i]).index);
         }
 
-        void erase(const T& item){
-            auto [found, index] = find_item_index(item);
-            if (!found){
-                return;
+        return new_impl;
+    }
+
+    size_t size() const {return m_hash_table_size;}
+    size_t element_count() const {return m_num_elements;}
+    size_t used_count() const {return m_num_used;}
+
+    size_t next_assigned(size_t index) const {
+        return m_field_states.next_assigned(index);
+    }
+
+    const T& at(size_t index) const {
+        return m_hash_table.get()[index];
+    }
+private:
+    size_t m_hash_table_size;
+    state_vector m_field_states;
+    std::unique_ptr<T, std::function<void (T*)>> m_hash_table;
+    std::hash<T> m_hash_function;
+    Allocator& m_allocator;
+    size_t m_num_elements = 0;
+    /// Number of fields which aren't free, i.e. assigned and deleted ones
+    size_t m_num_used = 0;
+
+    size_t get_first_possible_index(const T& item) const {
+        auto hashed_n = m_hash_function(item);
+        return hashed_n % m_hash_table_size;
+    }
+
+    /// Search for next free index for inserting a new item
+    /// Return true, index of the item if same item was found
+    /// Return false, index of the first deleted or free field otherwise
+    item_index_search_result find_next_free_index(const T& item, size_t index) {
+        auto first_deleted = m_hash_table_size;
+        while(true){
+            const auto field_state = m_field_states.get_state(index);
+            if(field_state == field_state::FREE){
+                return {false, first_deleted != m_hash_table_size ? first_deleted : index};
+            }
+            // The item may still follow a deleted field, so keep searching
+            if(field_state == field_state::DELETED && first_deleted == m_hash_table_size){
+                first_deleted = index;
             }
+            if(field_state == field_state::ASSIGNED && m_hash_table.get()[index] == item){
+                return {true, index};
+            }
+            ++index;
+            if(index >= m_hash_table_size){
+                index = 0;
+            }
+        }
+    }
 
-            m_field_states.set_state(index, field_state::DELETED);
-            m_hash_table.get()[index].~T();
+    void insert_to_index(const T& item, size_t index){
+        if(m_field_states.get_state(index) == field_state::FREE){
+            ++m_num_used;
         }
+        m_field_states.set_state(index, field_state::ASSIGNED);
+        auto field_ptr = &m_hash_table.get()[index];
+        new (field_ptr) T(item);
+        ++m_num_elements;
+    }
+};
 
-        /// Creates impl with same items but bigger table
-        impl create_bigger_self(){
-            impl new_impl{2 * m_hash_table_size, m_allocator};
+/// Hash set implemented using linear probing
+template<typename T, typename Allocator = std::allocator<T>> class hash_set_linear_probing {
+    using impl = linear_probing_table<T, Allocator>;
+public:
+    class const_iterator;
+    using iterator = const_iterator;
 
-            for(size_t i = 0; i < m_hash_table_size; ++i){
-                if(m_field_states.get_state(i) != field_state::ASSIGNED){
-                    continue;
-                }
-                new_impl.insert(m_hash_table.get()[i]);
-            }
+    hash_set_linear_probing() : hash_set_linear_probing(Allocator()){}
 
-            return new_impl;
+    explicit hash_set_linear_probing(const Allocator& allocator) : m_allocator{allocator}, m_impl{INITIAL_HASH_TABLE_SIZE, m_allocator} {}
+
+    hash_set_linear_probing(const hash_set_linear_probing& other) : m_allocator{other.m_allocator}, m_impl{other.m_impl, m_allocator} {}
+
+    hash_set_linear_probing& operator=(const hash_set_linear_probing& other){
+        m_impl = impl{other.m_impl, m_allocator};
+        return *this;
+    }
+
+    /// Insert item into set
+    void insert(const T& item){
+        bool actually_inserted = m_impl.insert(item);
+        if(!actually_inserted){
+            return;
         }
+        // If number of used fields grows sufficiently, grow the bucket count
+        // Please note without resizing the implementation will break!
+        if(m_impl.used_count() > MAX_LOAD * m_impl.size()){
+            // Table full mostly of deleted fields only needs to be cleaned, not grown
+            auto grow = m_impl.element_count() > MAX_LOAD / 2 * m_impl.size();
+            m_impl = m_impl.create_resized_self(grow ? 2 * m_impl.size() : m_impl.size());
+        }
+    }
 
-        size_t size(){return m_hash_table_size;}
-    private:
-        size_t m_hash_table_size;
-        state_vector m_field_states;
-        std::unique_ptr<T, std::function<void (T*)>> m_hash_table;
-        std::hash<T> m_hash_function;
-        Allocator& m_allocator;
+    /// Searches for item in set
+    bool find(const T& item) const{
+        return m_impl.find(item);
+    }
 
-        size_t get_first_possible_index(const T& item) const {
-            auto hashed_n = m_hash_function(item);
-            return hashed_n % m_hash_table_size;
+    void erase(const T& item){
+        m_impl.erase(item);
+    }
+
+    /// Removes all items for which predicate returns true
+    /// Returns number of removed items
+    template<typename Predicate> size_t erase_if(Predicate predicate){
+        return m_impl.erase_if(predicate);
+    }
+
+    /// Number of items in set
+    size_t size() const {
+        return m_impl.element_count();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const_iterator begin() const {
+        return {&m_impl, m_impl.next_assigned(0)};
+    }
+
+    const_iterator end() const {
+        return {&m_impl, m_impl.size()};
+    }
+
+    /// Union of two sets, copies the bigger one and inserts items of the smaller one
+    friend hash_set_linear_probing operator|(const hash_set_linear_probing& lhs, const hash_set_linear_probing& rhs){
+        const auto& bigger = lhs.size() >= rhs.size() ? lhs : rhs;
+        const auto& smaller = lhs.size() >= rhs.size() ? rhs : lhs;
+
+        hash_set_linear_probing result{bigger};
+        for(const auto& item: smaller){
+            result.insert(item);
         }
+        return result;
+    }
 
-        struct item_index_search_result {
-            bool found;
-            size_t index;
-        };
+    /// Intersection of two sets, iterates the smaller one and searches in the bigger one
+    friend hash_set_linear_probing operator&(const hash_set_linear_probing& lhs, const hash_set_linear_probing& rhs){
+        const auto& bigger = lhs.size() >= rhs.size() ? lhs : rhs;
+        const auto& smaller = lhs.size() >= rhs.size() ? rhs : lhs;
 
-        /// Search for next free index for inserting a new item
-        /// Return true, 0 if same item was found
-        /// Return false, index of the next free index
-        item_index_search_result find_next_free_index(const T& item, size_t index) {
-            while(true){
-                if(m_field_states.get_state(index) != field_state::ASSIGNED){
-                    return {false, index};
-                }
-                if(m_hash_table.get()[index] == item){
-                    return {true, 0};
-                }
-                ++index;
-                if(index >= m_hash_table_size){
-                    index = 0;
-                }
+        hash_set_linear_probing result;
+        for(const auto& item: smaller){
+            if(bigger.find(item)){
+                result.insert(item);
             }
         }
+        return result;
+    }
 
-        void insert_to_index(const T& item, size_t index){
-            m_field_states.set_state(index, field_state::ASSIGNED);
-            auto field_ptr = &m_hash_table.get()[index];
-            new (field_ptr) T(item);
-        }
-
-        item_index_search_result find_item_index(const T& item) const {
-            auto index = get_first_possible_index(item);
-            while(true){
-                const auto field_state = m_field_states.get_state(index);
-                if(field_state == field_state::FREE){
-                    return {false, 0};
-                }
-                if(field_state == field_state::ASSIGNED && m_hash_table.get()[index] == item){
-                    return {true, index};
-                }
-                ++index;
-                if(index >= m_hash_table_size){
-                    index = 0;
-                }
-            }
+private:
+    Allocator m_allocator;
+    impl m_impl;
+    static constexpr size_t INITIAL_HASH_TABLE_SIZE = 1024;
+    static constexpr float MAX_LOAD = 0.7f;
+
+public:
+    /// Forward iterator over items, skips unassigned fields a word of states at a time
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+        const_iterator(const impl* table, size_t index) : m_table{table}, m_index{index} {}
+
+        reference operator*() const {return m_table->at(m_index);}
+        pointer operator->() const {return &m_table->at(m_index);}
+
+        const_iterator& operator++(){
+            m_index = m_table->next_assigned(m_index + 1);
+            return *this;
         }
+        const_iterator operator++(int){
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const {return m_index == other.m_index;}
+        bool operator!=(const const_iterator& other) const {return m_index != other.m_index;}
+
+    private:
+        const impl* m_table = nullptr;
+        size_t m_index = 0;
     };
 };
 
@@ -4,12 +4,16 @@
 #define HW1_HASH_LINKED_LIST_HH
 
 #include <functional>
+#include <iterator>
 #include <vector>
 #include <algorithm>
 
 /// Hash set implemented using linked list (although internally std::vector is used)
 template<typename T, typename = void> class hash_set_linked_list {
+    class impl;
 public:
+    class const_iterator;
+    using iterator = const_iterator;
 
     /// Inserts item into set
     void insert(const T& item){
@@ -40,8 +44,58 @@ public:
         }
     }
 
+    /// Removes all items for which predicate returns true
+    /// Returns number of removed items
+    template<typename Predicate> size_t erase_if(Predicate predicate){
+        auto erased = m_impl.erase_if(predicate);
+        m_num_elements -= erased;
+        return erased;
+    }
+
+    /// Number of items in set
+    size_t size() const {
+        return m_num_elements;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const_iterator begin() const {
+        return {&m_impl, m_impl.next_nonempty_bucket(0), 0};
+    }
+
+    const_iterator end() const {
+        return {&m_impl, m_impl.bucket_count(), 0};
+    }
+
+    /// Union of two sets, copies the bigger one and inserts items of the smaller one
+    friend hash_set_linked_list operator|(const hash_set_linked_list& lhs, const hash_set_linked_list& rhs){
+        const auto& bigger = lhs.size() >= rhs.size() ? lhs : rhs;
+        const auto& smaller = lhs.size() >= rhs.size() ? rhs : lhs;
+
+        hash_set_linked_list result{bigger};
+        for(const auto& item: smaller){
+            result.insert(item);
+        }
+        return result;
+    }
+
+    /// Intersection of two sets, iterates the smaller one and searches in the bigger one
+    friend hash_set_linked_list operator&(const hash_set_linked_list& lhs, const hash_set_linked_list& rhs){
+        const auto& bigger = lhs.size() >= rhs.size() ? lhs : rhs;
+        const auto& smaller = lhs.size() >= rhs.size() ? rhs : lhs;
+
+        hash_set_linked_list result;
+        for(const auto& item: smaller){
+            if(bigger.find(item)){
+                result.insert(item);
+            }
+        }
+        return result;
+    }
+
 private:
-    class impl;
     impl m_impl{INITIAL_BUCKET_NUMBER};
     constexpr static size_t INITIAL_BUCKET_NUMBER = 10;
     constexpr static float GROW_FACTOR = 2;
@@ -67,10 +121,23 @@ private:
             return find_in_bucket(bucket, item);
         }
 
-        size_t bucket_count(){
+        size_t bucket_count() const {
             return m_bucket_count;
         }
 
+        /// Returns index of the first nonempty bucket at or after bucket,
+        /// or bucket count if there is no such bucket
+        size_t next_nonempty_bucket(size_t bucket) const {
+            while(bucket < m_bucket_count && m_buckets[bucket].empty()){
+                ++bucket;
+            }
+            return bucket;
+        }
+
+        const std::vector<T>& bucket_at(size_t bucket) const {
+            return m_buckets[bucket];
+        }
+
         /// Creates impl with same items but bigger bucket count
         impl create_bigger_self(){
             impl new_impl{static_cast<size_t>(GROW_FACTOR * m_bucket_count)};
@@ -94,6 +161,18 @@ private:
             return true;
         }
 
+        template<typename Predicate> size_t erase_if(Predicate& predicate){
+            size_t erased = 0;
+            for(auto& bucket: m_buckets){
+                auto new_end = std::remove_if(std::begin(bucket), std::end(bucket), [&predicate](const T& item){
+                    return predicate(item);
+                });
+                erased += std::end(bucket) - new_end;
+                bucket.erase(new_end, std::end(bucket));
+            }
+            return erased;
+        }
+
     private:
         std::vector<std::vector<T>> m_buckets;
         size_t m_bucket_count;
@@ -115,6 +194,47 @@ private:
             return std::find(std::begin(bucket), std::end(bucket), item) != std::end(bucket);
         }
     };
+
+public:
+    /// Forward iterator over items, walks buckets in order skipping empty ones
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+        const_iterator(const impl* table, size_t bucket, size_t position) : m_table{table}, m_bucket{bucket}, m_position{position} {}
+
+        reference operator*() const {return m_table->bucket_at(m_bucket)[m_position];}
+        pointer operator->() const {return &**this;}
+
+        const_iterator& operator++(){
+            ++m_position;
+            if(m_position >= m_table->bucket_at(m_bucket).size()){
+                m_bucket = m_table->next_nonempty_bucket(m_bucket + 1);
+                m_position = 0;
+            }
+            return *this;
+        }
+        const_iterator operator++(int){
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return m_bucket == other.m_bucket && m_position == other.m_position;
+        }
+        bool operator!=(const const_iterator& other) const {return !(*this == other);}
+
+    private:
+        const impl* m_table = nullptr;
+        size_t m_bucket = 0;
+        size_t m_position = 0;
+    };
 };
 
 #endif //HW1_HASH_LINKED_LIST_HH
@@ -0,0 +1,221 @@
+/// Part of PB173 homework, created by Ondřej Budai <ondrej@budai.cz>
+
+#ifndef HW2_HASH_SET_STRING_ARENA_HH
+#define HW2_HASH_SET_STRING_ARENA_HH
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Hash set of strings implemented using linear probing
+/// Bytes of all keys live in one contiguous append-only arena, table only stores
+/// offset, length and hash of each key, so inserting doesn't allocate per key
+class hash_set_string_arena {
+public:
+
+    /// Insert item into set
+    void insert(std::string_view item){
+        // Grow before inserting, so find_slot always finds a free slot
+        // If the table is mostly full of tombstones, rebuilding at same size is enough
+        if(m_num_used + 1 > MAX_LOAD * m_slots.size()){
+            auto grow = m_num_elements + 1 > MAX_LOAD / 2 * m_slots.size();
+            rebuild(grow ? 2 * m_slots.size() : m_slots.size());
+        }
+        else if(m_erased_bytes > m_arena.size() / 2 && m_erased_bytes > INITIAL_HASH_TABLE_SIZE){
+            rebuild(m_slots.size());
+        }
+
+        const auto hash = m_hash_function(item);
+        auto [found, index] = find_slot(item, hash);
+        if(found){
+            return;
+        }
+
+        if(m_slots[index].offset == FREE){
+            ++m_num_used;
+        }
+        m_slots[index] = {hash, append_to_arena(item), static_cast<uint32_t>(item.size())};
+        ++m_num_elements;
+    }
+
+    /// Searches for item in set
+    bool find(std::string_view item) const {
+        return find_slot(item, m_hash_function(item)).found;
+    }
+
+    /// Removes item from set, its bytes stay in arena until next rebuild
+    void erase(std::string_view item){
+        auto [found, index] = find_slot(item, m_hash_function(item));
+        if(!found){
+            return;
+        }
+
+        m_slots[index].offset = DELETED;
+        m_erased_bytes += m_slots[index].length;
+        --m_num_elements;
+    }
+
+    /// Number of items in set
+    size_t size() const {
+        return m_num_elements;
+    }
+
+    class const_iterator;
+
+    const_iterator begin() const {
+        return {this, next_assigned(0)};
+    }
+
+    const_iterator end() const {
+        return {this, m_slots.size()};
+    }
+
+    /// Number of bytes currently occupied by the arena, including erased keys
+    size_t arena_size() const {
+        return m_arena.size();
+    }
+
+private:
+    static constexpr size_t INITIAL_HASH_TABLE_SIZE = 1024;
+    static constexpr float MAX_LOAD = 0.7f;
+    static constexpr uint32_t FREE = std::numeric_limits<uint32_t>::max();
+    static constexpr uint32_t DELETED = FREE - 1;
+
+    /// One field of the hash table, the key itself is m_arena[offset, offset + length)
+    struct slot {
+        size_t hash;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct slot_search_result {
+        bool found;
+        size_t index;
+    };
+
+    std::vector<slot> m_slots = std::vector<slot>(INITIAL_HASH_TABLE_SIZE, slot{0, FREE, 0});
+    std::vector<char> m_arena;
+    std::hash<std::string_view> m_hash_function;
+    size_t m_num_elements = 0;
+    /// Number of slots which aren't FREE, i.e. elements plus tombstones
+    size_t m_num_used = 0;
+    /// Number of arena bytes belonging to erased keys
+    size_t m_erased_bytes = 0;
+
+    std::string_view key_of(const slot& s) const {
+        return {m_arena.data() + s.offset, s.length};
+    }
+
+    /// Returns index of the first slot holding a key at or after index, or table size if there is none
+    size_t next_assigned(size_t index) const {
+        while(index < m_slots.size() && (m_slots[index].offset == FREE || m_slots[index].offset == DELETED)){
+            ++index;
+        }
+        return index;
+    }
+
+    /// Search for item in table
+    /// Return true, index of the item if it was found
+    /// Return false, index of the first reusable (free or deleted) slot otherwise
+    slot_search_result find_slot(std::string_view item, size_t hash) const {
+        const auto mask = m_slots.size() - 1;
+        auto index = hash & mask;
+        auto reusable = m_slots.size();
+
+        while(true){
+            const auto& s = m_slots[index];
+            if(s.offset == FREE){
+                return {false, reusable != m_slots.size() ? reusable : index};
+            }
+            if(s.offset == DELETED){
+                if(reusable == m_slots.size()){
+                    reusable = index;
+                }
+            }
+            // Stored hash rejects almost all mismatches without touching the arena
+            else if(s.hash == hash && s.length == item.size() &&
+                    std::memcmp(m_arena.data() + s.offset, item.data(), item.size()) == 0){
+                return {true, index};
+            }
+            index = (index + 1) & mask;
+        }
+    }
+
+    uint32_t append_to_arena(std::string_view item){
+        if(m_arena.size() + item.size() >= DELETED || item.size() >= DELETED){
+            throw std::length_error("hash_set_string_arena: arena is limited to 4 GiB");
+        }
+        auto offset = static_cast<uint32_t>(m_arena.size());
+        m_arena.insert(std::end(m_arena), std::begin(item), std::end(item));
+        return offset;
+    }
+
+    /// Rehashes into table with new_size slots using stored hashes,
+    /// erased keys are dropped from the arena at the same time
+    void rebuild(size_t new_size){
+        std::vector<slot> new_slots(new_size, slot{0, FREE, 0});
+        std::vector<char> new_arena;
+        new_arena.reserve(m_arena.size());
+        const auto mask = new_size - 1;
+
+        for(const auto& s: m_slots){
+            if(s.offset == FREE || s.offset == DELETED){
+                continue;
+            }
+            auto index = s.hash & mask;
+            while(new_slots[index].offset != FREE){
+                index = (index + 1) & mask;
+            }
+            auto key = key_of(s);
+            new_slots[index] = {s.hash, static_cast<uint32_t>(new_arena.size()), s.length};
+            new_arena.insert(std::end(new_arena), std::begin(key), std::end(key));
+        }
+
+        m_slots = std::move(new_slots);
+        m_arena = std::move(new_arena);
+        m_num_used = m_num_elements;
+        m_erased_bytes = 0;
+    }
+
+public:
+    /// Forward iterator over keys, keys are returned as views into the arena
+    /// which are invalidated by the next insert
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        const_iterator() = default;
+        const_iterator(const hash_set_string_arena* set, size_t index) : m_set{set}, m_index{index} {}
+
+        reference operator*() const {return m_set->key_of(m_set->m_slots[m_index]);}
+
+        const_iterator& operator++(){
+            m_index = m_set->next_assigned(m_index + 1);
+            return *this;
+        }
+        const_iterator operator++(int){
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const {return m_index == other.m_index;}
+        bool operator!=(const const_iterator& other) const {return m_index != other.m_index;}
+
+    private:
+        const hash_set_string_arena* m_set = nullptr;
+        size_t m_index = 0;
+    };
+};
+
+#endif //HW2_HASH_SET_STRING_ARENA_HH
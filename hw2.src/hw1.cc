@@ -2,7 +2,11 @@
 
 #include "hash_set_linked_list.hh"
 #include "hash_set_linear_probing.hh"
+#include "hash_set_string_arena.hh"
+#include "hash_multiset_linear_probing.hh"
+#include "prefiltered_set.hh"
 
+#include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <ctime>
@@ -123,9 +127,59 @@ template<template<typename ...> typename Set> void generic_test_int() {
     }
 }
 
+template<template<typename ...> typename Set> void generic_test_iteration() {
+    Set<int> empty_set;
+    assert(empty_set.size() == 0);
+    assert(empty_set.begin() == empty_set.end());
 
-template<template<typename ...> typename Set> void generic_test_string() {
-    Set<std::string> set;
+    Set<int> set;
+    for(int i = 0; i < 3000; ++i){
+        set.insert(i);
+        set.insert(i);
+    }
+    assert(set.size() == 3000);
+
+    std::vector<int> items(std::begin(set), std::end(set));
+    std::sort(std::begin(items), std::end(items));
+    assert(items.size() == 3000);
+    for(int i = 0; i < 3000; ++i){
+        assert(items[i] == i);
+    }
+
+    // erase_if has to run in NDEBUG builds too, only the check of its result goes away
+    [[maybe_unused]] auto erased = set.erase_if([](int item){ return item % 3 == 0; });
+    assert(erased == 1000);
+    assert(set.size() == 2000);
+    for(int i = 0; i < 3000; ++i){
+        assert(set.find(i) == (i % 3 != 0));
+    }
+    assert(static_cast<size_t>(std::distance(std::begin(set), std::end(set))) == set.size());
+
+    // Deleted fields mustn't hide items inserted after them
+    set.insert(3);
+    set.insert(3);
+    assert(set.size() == 2001);
+
+    Set<int> set2;
+    for(int i = 2000; i < 5000; i += 2){
+        set2.insert(i);
+    }
+
+    auto united = set | set2;
+    auto intersected = set2 & set;
+    for(int i = 0; i < 6000; ++i){
+        assert(united.find(i) == (set.find(i) || set2.find(i)));
+        assert(intersected.find(i) == (set.find(i) && set2.find(i)));
+    }
+    assert(united.size() == static_cast<size_t>(std::distance(std::begin(united), std::end(united))));
+    assert(intersected.size() == static_cast<size_t>(std::distance(std::begin(intersected), std::end(intersected))));
+    // Operands stay untouched
+    assert(set.size() == 2001);
+    assert(set2.size() == 1500);
+}
+
+template<typename StringSet> void generic_test_string_set() {
+    StringSet set;
 
     set.insert("test");
     assert(set.find("test"));
@@ -134,7 +188,7 @@ template<template<typename ...> typename Set> void generic_test_string() {
     assert(set.find(""));
     assert(!set.find("kocka"));
 
-    Set<std::string> set2;
+    StringSet set2;
     std::vector<std::string> vector;
 
     for(auto i = 0; i < 2048; ++i){
@@ -163,13 +217,207 @@ template<template<typename ...> typename Set> void generic_test_string() {
     }
 }
 
+template<template<typename ...> typename Set> void generic_test_string() {
+    generic_test_string_set<Set<std::string>>();
+}
+
+void test_string_arena() {
+    hash_set_string_arena set;
+    std::vector<std::string> strings;
+
+    for(auto i = 0; i < 8096; ++i){
+        strings.emplace_back(std::to_string(i) + generate_random_string(i % 80));
+        set.insert(strings.back());
+        assert(set.find(strings.back()));
+    }
+    [[maybe_unused]] auto found = [&set](const std::string& str){ return set.find(str); };
+    assert(std::all_of(strings.begin(), strings.end(), found));
+
+    // Inserting duplicates mustn't grow the arena
+    [[maybe_unused]] auto arena_size = set.arena_size();
+    for(const auto& str: strings){
+        set.insert(str);
+    }
+    assert(set.arena_size() == arena_size);
+
+    for(size_t i = 0; i < strings.size(); i += 2){
+        set.erase(strings[i]);
+    }
+    for(size_t i = 0; i < strings.size(); ++i){
+        assert(set.find(strings[i]) == (i % 2 == 1));
+    }
+
+    // Reinserting into tombstones eventually compacts erased bytes away
+    for(size_t i = 0; i < strings.size(); i += 2){
+        set.insert(strings[i]);
+        set.erase(strings[i]);
+        set.insert(strings[i]);
+    }
+    assert(std::all_of(strings.begin(), strings.end(), found));
+    assert(set.arena_size() < 2 * arena_size);
+}
+
+void test_multiset() {
+    hash_multiset_linear_probing<int> multiset;
+    assert(multiset.count(1) == 0);
+    assert(!multiset.find(1));
+
+    multiset.insert(1);
+    multiset.increment(1);
+    multiset.increment(2, 5);
+    assert(multiset.count(1) == 2);
+    assert(multiset.count(2) == 5);
+    assert(multiset.size() == 2);
+
+    // Counts over 254 are spilled to wide counters
+    multiset.increment(3, 250);
+    multiset.increment(3, 10);
+    multiset.increment(4, 1000000000000);
+    for(int i = 0; i < 300; ++i){
+        multiset.increment(5);
+    }
+    assert(multiset.count(3) == 260);
+    assert(multiset.count(4) == 1000000000000);
+    assert(multiset.count(5) == 300);
+
+    // Spilled counters must survive rehashing
+    for(int i = 100; i < 5000; ++i){
+        multiset.increment(i, i % 7 + 1);
+    }
+    assert(multiset.count(3) == 260);
+    assert(multiset.count(4) == 1000000000000);
+    assert(multiset.count(5) == 300);
+    assert(multiset.size() == 5 + 4900);
+    for(int i = 100; i < 5000; ++i){
+        assert(multiset.count(i) == static_cast<uint64_t>(i % 7 + 1));
+    }
+
+    hash_multiset_linear_probing<int> other;
+    for(int i = 4000; i < 6000; ++i){
+        other.increment(i, 300);
+    }
+    multiset.merge(other);
+    assert(multiset.size() == 5 + 5900);
+    for(int i = 100; i < 6000; ++i){
+        assert(multiset.count(i) == static_cast<uint64_t>((i < 5000 ? i % 7 + 1 : 0) + (i >= 4000 ? 300 : 0)));
+    }
+
+    uint64_t total = 0;
+    multiset.for_each([&total](int, uint64_t count){ total += count; });
+    assert(total > 1000000000000);
+
+    // Byte counter holds up to 254, going over and back moves the count between the tables
+    hash_multiset_linear_probing<int> edges;
+    edges.increment(1, 254);
+    assert(edges.count(1) == 254);
+    edges.increment(1);
+    assert(edges.count(1) == 255);
+    assert(edges.decrement(1) == 1);
+    assert(edges.count(1) == 254);
+    // Huge increments saturate instead of wrapping
+    edges.increment(2, 10);
+    edges.increment(2, UINT64_MAX - 5);
+    assert(edges.count(2) == UINT64_MAX);
+    edges.increment(2, UINT64_MAX);
+    assert(edges.count(2) == UINT64_MAX);
+    edges.increment(3, 200);
+    edges.increment(3, UINT64_MAX - 100);
+    assert(edges.count(3) == UINT64_MAX);
+
+    assert(edges.decrement(1, 1000) == 254);
+    assert(!edges.find(1));
+    assert(edges.erase(2) == UINT64_MAX);
+    assert(edges.erase(2) == 0);
+    assert(edges.size() == 1);
+    // Fields of removed items are reused with fresh counters
+    edges.increment(1, 3);
+    edges.increment(2);
+    assert(edges.count(1) == 3);
+    assert(edges.count(2) == 1);
+
+    // Erasing most items cleans the table of deleted fields instead of growing it
+    for(int round = 0; round < 10; ++round){
+        for(int i = 1000; i < 1600; ++i){
+            edges.increment(i, 300);
+        }
+        for(int i = 1000; i < 1600; ++i){
+            assert(edges.erase(i) == 300);
+        }
+    }
+    assert(edges.size() == 3);
+    assert(edges.count(3) == UINT64_MAX);
+
+    hash_multiset_linear_probing<std::string> strings;
+    strings.insert("kocka");
+    strings.insert("kocka");
+    strings.insert("pes");
+    assert(strings.count("kocka") == 2);
+    assert(strings.count("pes") == 1);
+    assert(strings.count("") == 0);
+}
+
+void test_bloom_filter() {
+    auto detected = blocked_bloom_filter::active_simd();
+    std::vector<uint64_t> hashes;
+    std::vector<uint64_t> others;
+    std::mt19937_64 random_engine;
+    for(int i = 0; i < 10000; ++i){
+        hashes.emplace_back(random_engine());
+    }
+    for(int i = 0; i < 100000; ++i){
+        others.emplace_back(random_engine());
+    }
+
+    // Every variant must set and test the same bits, so their answers are compared one by one
+    std::vector<std::vector<bool>> answers;
+    for(auto level: {blocked_bloom_filter::simd::scalar, detected}){
+        blocked_bloom_filter::active_simd() = level;
+        blocked_bloom_filter filter{10000};
+        for(auto hash: hashes){
+            filter.add(hash);
+        }
+        assert(std::all_of(hashes.begin(), hashes.end(), [&filter](uint64_t hash){ return filter.may_contain(hash); }));
+
+        answers.emplace_back();
+        int false_positives = 0;
+        for(auto hash: others){
+            answers.back().push_back(filter.may_contain(hash));
+            false_positives += answers.back().back();
+        }
+        // Expected rate is around 0.1 %
+        assert(false_positives < 1000);
+    }
+    assert(answers.front() == answers.back());
+
+    // Filter built by one variant is read by the other
+    blocked_bloom_filter::active_simd() = blocked_bloom_filter::simd::scalar;
+    blocked_bloom_filter filter{10000};
+    for(auto hash: hashes){
+        filter.add(hash);
+    }
+    blocked_bloom_filter::active_simd() = detected;
+    assert(std::all_of(hashes.begin(), hashes.end(), [&filter](uint64_t hash){ return filter.may_contain(hash); }));
+}
+
 void test() {
     std::cout << "Testing hash table using linked lists." << std::endl;
     generic_test_int<hash_set_linked_list>();
     generic_test_string<hash_set_linked_list>();
+    generic_test_iteration<hash_set_linked_list>();
     std::cout << "Testing hash table using linear probing." << std::endl;
     generic_test_int<hash_set_linear_probing>();
     generic_test_string<hash_set_linear_probing>();
+    generic_test_iteration<hash_set_linear_probing>();
+    std::cout << "Testing string hash table using arena." << std::endl;
+    generic_test_string_set<hash_set_string_arena>();
+    test_string_arena();
+    std::cout << "Testing hash tables with Bloom filter." << std::endl;
+    test_bloom_filter();
+    generic_test_int<prefiltered_set>();
+    generic_test_string<prefiltered_set>();
+    generic_test_string_set<prefiltered_set<std::string, hash_set_string_arena>>();
+    std::cout << "Testing multiset using linear probing." << std::endl;
+    test_multiset();
 
     std::cout << "Tests successfully ran." << std::endl << std::endl;
 }
@@ -235,8 +483,8 @@ template<typename StringSet> void generic_benchmark_string_find_not_included(Str
     std::cout << "Searching for random strings not contained in set: " << (1000.0 * time / CLOCKS_PER_SEC) << "ms" << std::endl;
 }
 
-template<template<typename ...> typename Set> void generic_benchmark_string(){
-    Set<std::string> set;
+template<typename StringSet> void generic_benchmark_string_set(){
+    StringSet set;
     std::vector<std::string> generated_strings;
     generic_benchmark_string_insert(set, generated_strings);
     generic_benchmark_string_find_included(set, generated_strings);
@@ -244,6 +492,10 @@ template<template<typename ...> typename Set> void generic_benchmark_string(){
 
 }
 
+template<template<typename ...> typename Set> void generic_benchmark_string(){
+    generic_benchmark_string_set<Set<std::string>>();
+}
+
 void benchmark() {
     std::cout << "Benchmarking hash table with linked list:" << std::endl;
     std::cout << "=========================================" << std::endl;
@@ -257,6 +509,18 @@ void benchmark() {
     generic_benchmark_string<hash_set_linear_probing>();
     std::cout << std::endl;
 
+    std::cout << "Benchmarking string hash table with arena:" << std::endl;
+    std::cout << "==========================================" << std::endl;
+    generic_benchmark_string_set<hash_set_string_arena>();
+    std::cout << std::endl;
+
+    std::cout << "Benchmarking hash tables with Bloom filter:" << std::endl;
+    std::cout << "===========================================" << std::endl;
+    generic_benchmark_int<prefiltered_set>();
+    generic_benchmark_string<prefiltered_set>();
+    generic_benchmark_string_set<prefiltered_set<std::string, hash_set_string_arena>>();
+    std::cout << std::endl;
+
     std::cout << "Benchmarking std::unordered_set:" << std::endl;
     std::cout << "================================" << std::endl;
     generic_benchmark_int<std::unordered_set>();
@@ -1,96 +1,117 @@
-#include "hash_set_linked_list.hh"
-#include "hash_set_linear_probing.hh"
+/// Part of PB173 homework, created by Ondřej Budai <ondrej@budai.cz>
 
+#define BRICK_BENCHMARK_REG
+#define BRICK_BENCHMARK_MAIN
 
-int main(){}
+/* ./hw2-bench category:hashset | gnuplot > hashset.pdf
+ * ./hw2-bench category:hashset type:int hits:10 test:find   only one of the benchmarks */
 
+#include <brick-benchmark>
+#include "bench_common.hh"
 
+using namespace brick;
 
+/// Axes shared by all hash set benchmarks: items in set on x, implementation on y
+template<typename Key>
+void setup_axes(benchmark::Axis& x, benchmark::Axis& y){
+    x.type = benchmark::Axis::Quantitative;
+    x.name = "items";
+    x.min = bench::MIN_ITEMS;
+    x.max = std::is_same_v<Key, std::string> ? bench::MAX_STRING_ITEMS : bench::MAX_INT_ITEMS;
+    x.step = 10;
+    x.log = true;
 
-#define BRICK_BENCHMARK_REG
-//#define BRICK_BENCHMARK_MAIN
-
-/* ./bench category:stack | gnuplot > soubor.pdf */
-
-//#include <brick-benchmark>
-//
-//using namespace brick;
-//
-//struct Stack : benchmark::Group
-//{
-//    static constexpr int items = 100000;
-//    std::list<int> m_list;
-//    std::vector<int> m_vector;
-//    Stack()
-//    {
-//        x.type = benchmark::Axis::Quantitative;
-//        x.name = "items";
-//        x.min = 1;
-//        x.max = 65536;
-//        x.step = 16;
-//        x.log = true;
-//
-//        y.type = benchmark::Axis::Qualitative;
-//        y.name = "implementation";
-//        y.min = 1;
-//        y.max = 1;
-//        y._render = []( int i )
-//        {
-//            switch ( i )
-//            {
-//                case 1: return "list";
-//                case 2: return "vector";
-//            }
-//        };
-//
-//
-//    }
-//
-//    void setup(int p, int q) override {
-//        benchmark::Group::setup(p, q);
-//
-//        m_list.clear();
-//        m_vector.clear();
-//        for(auto i = 0; i < p; ++i){
-//            m_list.push_back(i);
-//            m_vector.push_back(i);
-//        }
-//
-//        static std::mt19937 random;
-//
-//        m_list_iterator = std::begin(m_list);
-//
-//        for(auto i = 0; i < random() % p; ++i){
-//            ++m_list_iterator;
-//        }
-//    }
-//
-//
-//
-//    std::string describe() { return "category:stack"; }
-//
-//    BENCHMARK( read )
-//    {
-//        switch ( q )
-//        {
-//            case 1: read_list(); break;
-//            case 2: read_list(); break;
-//        }
-//    }
-//
-//    double normal() override {
-//        return 1.0;
-//    }
-//
-//    void read_list(){
-//        int len = 1024;
-//        auto a = 0;
-//        for(auto i = 0; i < len; ++i){
-//
-//        }
-//    }
-//
-//    std::list<int>::iterator m_list_iterator;
-//};
+    using impls = bench::implementations<Key>;
+    y.type = benchmark::Axis::Qualitative;
+    y.name = "implementation";
+    y.min = 1;
+    y.max = impls::names.size();
+    y._render = []( int64_t i ) { return std::string{impls::names[i - 1]}; };
+}
+
+std::string key_name(int){ return "int"; }
+std::string key_name(const std::string&){ return "string"; }
+
+/// Time of inserting all pregenerated keys into an empty set, per inserted item
+template<typename Key>
+struct HashSetInsert : benchmark::Group
+{
+    std::vector<Key> keys;
+    typename bench::implementations<Key>::sets sets;
+
+    HashSetInsert()
+    {
+        setup_axes<Key>(x, y);
+        x.normalize = benchmark::Axis::Div;
+    }
+
+    void setup(int p, int q) override {
+        benchmark::Group::setup(p, q);
+        keys = bench::make_inserted_keys<Key>(p);
+    }
+
+    std::string describe() override { return "category:hashset type:" + key_name(Key{}); }
+
+    BENCHMARK(insert)
+    {
+        bench::visit_at(sets, q - 1, [this](auto& set){
+            for(const auto& key: keys){
+                set.insert(key);
+            }
+        });
+    }
+};
+
+/// Time of LOOKUPS searches in a prefilled set, per search
+/// HitPercent of searched keys are present in the set
+template<typename Key, int HitPercent>
+struct HashSetFind : benchmark::Group
+{
+    std::vector<Key> lookups;
+    typename bench::implementations<Key>::sets sets;
+    size_t found = 0;
+
+    HashSetFind()
+    {
+        setup_axes<Key>(x, y);
+    }
+
+    void setup(int p, int q) override {
+        benchmark::Group::setup(p, q);
+        auto keys = bench::make_inserted_keys<Key>(p);
+        lookups = bench::make_lookup_keys(keys, bench::LOOKUPS, HitPercent);
+        bench::visit_at(sets, q - 1, [&keys](auto& set){
+            for(const auto& key: keys){
+                set.insert(key);
+            }
+        });
+    }
+
+    std::string describe() override {
+        return "category:hashset type:" + key_name(Key{}) + " hits:" + std::to_string(HitPercent);
+    }
+
+    double normal() override { return 1.0 / bench::LOOKUPS; }
 
+    BENCHMARK(find)
+    {
+        bench::visit_at(sets, q - 1, [this](const auto& set){
+            for(const auto& key: lookups){
+                found += bench::contains(set, key);
+            }
+        });
+        // Make the result observable, so the searches can't be optimized away
+        if(found > lookups.size()){
+            std::cerr << found << std::endl;
+        }
+    }
+};
 
+template struct HashSetInsert<int>;
+template struct HashSetInsert<std::string>;
+template struct HashSetFind<int, 0>;
+template struct HashSetFind<int, 10>;
+template struct HashSetFind<int, 100>;
+template struct HashSetFind<std::string, 0>;
+template struct HashSetFind<std::string, 10>;
+template struct HashSetFind<std::string, 100>;
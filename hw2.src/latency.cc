@@ -0,0 +1,95 @@
+/// Part of PB173 homework, created by Ondřej Budai <ondrej@budai.cz>
+
+/* Prints per-operation latency percentiles of the hash sets
+ * ./hw2-latency [max items]   defaults to 10M items */
+
+#include "bench_common.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+/// Operations are timed in batches, a single operation is shorter than resolution of the clock
+constexpr size_t BATCH = 16;
+
+struct percentiles {
+    double p50, p90, p99, p999, max;
+};
+
+/// Times operation(item) for every item in batches of BATCH, returns nanoseconds per operation
+template<typename Item, typename Operation>
+percentiles measure(const std::vector<Item>& items, Operation&& operation){
+    using clock = std::chrono::steady_clock;
+    std::vector<double> samples;
+    samples.reserve(items.size() / BATCH + 1);
+
+    for(size_t begin = 0; begin < items.size(); begin += BATCH){
+        auto end = std::min(begin + BATCH, items.size());
+        auto start = clock::now();
+        for(auto i = begin; i < end; ++i){
+            operation(items[i]);
+        }
+        auto stop = clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(stop - start).count() / (end - begin));
+    }
+
+    std::sort(std::begin(samples), std::end(samples));
+    auto at = [&samples](double quantile){
+        return samples[static_cast<size_t>(quantile * (samples.size() - 1))];
+    };
+    return {at(0.5), at(0.9), at(0.99), at(0.999), samples.back()};
+}
+
+void print_row(const std::string& key_type, const char* implementation, size_t items, const std::string& operation, const percentiles& result){
+    std::cout << std::left << std::setw(7) << key_type
+              << std::setw(20) << implementation
+              << std::right << std::setw(10) << items << "  "
+              << std::left << std::setw(10) << operation
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(9) << result.p50
+              << std::setw(9) << result.p90
+              << std::setw(9) << result.p99
+              << std::setw(9) << result.p999
+              << std::setw(11) << result.max << std::endl;
+}
+
+template<typename Key> void measure_key_type(const std::string& key_type, size_t max_items){
+    using impls = bench::implementations<Key>;
+    size_t found = 0;
+
+    for(size_t items = bench::MIN_ITEMS; items <= max_items; items *= 10){
+        auto keys = bench::make_inserted_keys<Key>(items);
+
+        for(size_t impl = 0; impl < impls::names.size(); ++impl){
+            typename impls::sets sets;
+            bench::visit_at(sets, impl, [&](auto& set){
+                // Insert latency includes the occasional rehash, which is what the tail shows
+                auto insert = measure(keys, [&set](const Key& key){ set.insert(key); });
+                print_row(key_type, impls::names[impl], items, "insert", insert);
+
+                for(auto hit_percent: {0, 10, 100}){
+                    auto lookups = bench::make_lookup_keys(keys, bench::LOOKUPS, hit_percent);
+                    auto find = measure(lookups, [&set, &found](const Key& key){ found += bench::contains(set, key); });
+                    print_row(key_type, impls::names[impl], items, "find " + std::to_string(hit_percent) + "%", find);
+                }
+            });
+        }
+    }
+
+    // Make the result observable, so the searches can't be optimized away
+    if(found == 0){
+        std::cerr << "No key was ever found" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_items = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : bench::MAX_STRING_ITEMS;
+
+    std::cout << "# nanoseconds per operation, operations timed in batches of " << BATCH << std::endl;
+    std::cout << "# type  implementation           items  operation     p50      p90      p99    p99.9        max" << std::endl;
+    measure_key_type<int>("int", std::min<size_t>(max_items, bench::MAX_INT_ITEMS));
+    measure_key_type<std::string>("string", std::min<size_t>(max_items, bench::MAX_STRING_ITEMS));
+    return 0;
+}
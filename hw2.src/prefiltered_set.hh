@@ -0,0 +1,93 @@
+/// Part of PB173 homework, created by Ondřej Budai <ondrej@budai.cz>
+
+#ifndef HW2_PREFILTERED_SET_HH
+#define HW2_PREFILTERED_SET_HH
+
+#include "blocked_bloom_filter.hh"
+#include "hash_set_linear_probing.hh"
+
+#include <functional>
+
+/// Hash set with a blocked Bloom filter in front of it
+/// Most searches for missing items are answered from one cache line of the filter
+/// without touching the set, which pays off when most searched items are missing
+/// Set has to provide insert, find, erase, size and iteration
+template<typename T, typename Set = hash_set_linear_probing<T>> class prefiltered_set {
+public:
+
+    /// Insert item into set
+    void insert(const T& item){
+        auto old_size = m_set.size();
+        m_set.insert(item);
+        if(m_set.size() == old_size){
+            return;
+        }
+        m_filter.add(filter_hash(item));
+        // Filter too full would let through too many missing items, so build a bigger one
+        if(m_set.size() > m_filter_capacity){
+            rebuild_filter(2 * m_filter_capacity);
+        }
+    }
+
+    /// Searches for item in set
+    bool find(const T& item) const {
+        if(!m_filter.may_contain(filter_hash(item))){
+            return false;
+        }
+        return m_set.find(item);
+    }
+
+    /// Removes item from set, filter keeps its bits until it is rebuilt
+    void erase(const T& item){
+        auto old_size = m_set.size();
+        m_set.erase(item);
+        if(m_set.size() == old_size){
+            return;
+        }
+        ++m_num_stale;
+        if(m_num_stale > m_filter_capacity / 2){
+            rebuild_filter(m_filter_capacity);
+        }
+    }
+
+    size_t size() const {
+        return m_set.size();
+    }
+
+    /// Underlying set, for operations which the filter doesn't need to know about
+    const Set& set() const {
+        return m_set;
+    }
+
+private:
+    static constexpr size_t INITIAL_FILTER_CAPACITY = 1024;
+
+    Set m_set;
+    size_t m_filter_capacity = INITIAL_FILTER_CAPACITY;
+    blocked_bloom_filter m_filter{INITIAL_FILTER_CAPACITY};
+    /// Number of erased items whose bits are still set in the filter
+    size_t m_num_stale = 0;
+
+    /// std::hash of integers is identity, so mix it well before the filter splits it into block and bits
+    /// Templated, as iterating the set may give a different type with equal hash (std::string_view for std::string)
+    template<typename Item> static uint64_t filter_hash(const Item& item) {
+        uint64_t hash = std::hash<Item>{}(item);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    void rebuild_filter(size_t capacity){
+        m_filter_capacity = capacity;
+        m_filter = blocked_bloom_filter{capacity};
+        for(const auto& item: m_set){
+            m_filter.add(filter_hash(item));
+        }
+        m_num_stale = 0;
+    }
+};
+
+#endif //HW2_PREFILTERED_SET_HH
@@ -0,0 +1,239 @@
+#ifndef HW4_BITVECTOR_KERNELS_HH
+#define HW4_BITVECTOR_KERNELS_HH
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HW4_X86_KERNELS 1
+#endif
+
+/// Word-array kernels behind int16_set_bitvector set operations
+/// Vectorized variants are compiled with target attributes and picked at runtime by CPU,
+/// so the binary runs everywhere and doesn't need -march flags
+namespace detail::bitvector_kernels {
+    enum class simd { scalar, avx2, avx512 };
+
+    enum class operation { intersection, union_, difference, symmetric_difference };
+
+    inline simd detect_simd() noexcept {
+#ifdef HW4_X86_KERNELS
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")){
+            return simd::avx512;
+        }
+        if(__builtin_cpu_supports("avx2")){
+            return simd::avx2;
+        }
+#endif
+        return simd::scalar;
+    }
+
+    /// Kernels used by all bitvectors, tests may lower it to check the other variants
+    inline simd& active_simd() noexcept {
+        static simd level = detect_simd();
+        return level;
+    }
+
+    template<operation Op>
+    inline uint64_t combine_word(uint64_t lhs, uint64_t rhs) noexcept {
+        switch(Op){
+            case operation::intersection: return lhs & rhs;
+            case operation::union_: return lhs | rhs;
+            case operation::difference: return lhs & ~rhs;
+            case operation::symmetric_difference: return lhs ^ rhs;
+        }
+        return 0;
+    }
+
+    template<operation Op>
+    void combine_scalar(uint64_t* result, const uint64_t* lhs, const uint64_t* rhs, std::size_t count) noexcept {
+        for(std::size_t index = 0; index < count; ++index){
+            result[index] = combine_word<Op>(lhs[index], rhs[index]);
+        }
+    }
+
+    inline std::size_t popcount_scalar(const uint64_t* data, std::size_t count) noexcept {
+        std::size_t result = 0;
+        for(std::size_t index = 0; index < count; ++index){
+            result += __builtin_popcountll(data[index]);
+        }
+        return result;
+    }
+
+    template<operation Op>
+    std::size_t combine_count_scalar(const uint64_t* lhs, const uint64_t* rhs, std::size_t count) noexcept {
+        std::size_t result = 0;
+        for(std::size_t index = 0; index < count; ++index){
+            result += __builtin_popcountll(combine_word<Op>(lhs[index], rhs[index]));
+        }
+        return result;
+    }
+
+#ifdef HW4_X86_KERNELS
+    template<operation Op>
+    __attribute__((target("avx2"))) inline __m256i combine_avx2_vector(__m256i lhs, __m256i rhs) noexcept {
+        switch(Op){
+            case operation::intersection: return _mm256_and_si256(lhs, rhs);
+            case operation::union_: return _mm256_or_si256(lhs, rhs);
+            // andnot negates its first operand
+            case operation::difference: return _mm256_andnot_si256(rhs, lhs);
+            case operation::symmetric_difference: return _mm256_xor_si256(lhs, rhs);
+        }
+        return lhs;
+    }
+
+    /// Popcount of each byte by looking its nibbles up in a table (Muła's algorithm),
+    /// sums of bytes are then accumulated into four 64-bit counters
+    __attribute__((target("avx2"))) inline __m256i popcount_avx2_vector(__m256i data) noexcept {
+        const auto table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const auto low_mask = _mm256_set1_epi8(0x0f);
+        auto low = _mm256_and_si256(data, low_mask);
+        auto high = _mm256_and_si256(_mm256_srli_epi16(data, 4), low_mask);
+        auto bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, low), _mm256_shuffle_epi8(table, high));
+        return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+    }
+
+    __attribute__((target("avx2"))) inline std::size_t horizontal_sum_avx2(__m256i data) noexcept {
+        return _mm256_extract_epi64(data, 0) + _mm256_extract_epi64(data, 1) +
+               _mm256_extract_epi64(data, 2) + _mm256_extract_epi64(data, 3);
+    }
+
+    template<operation Op>
+    __attribute__((target("avx2"))) void combine_avx2(uint64_t* result, const uint64_t* lhs, const uint64_t* rhs, std::size_t count) noexcept {
+        std::size_t index = 0;
+        for(; index + 4 <= count; index += 4){
+            auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + index));
+            auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + index));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + index), combine_avx2_vector<Op>(a, b));
+        }
+        combine_scalar<Op>(result + index, lhs + index, rhs + index, count - index);
+    }
+
+    __attribute__((target("avx2"))) inline std::size_t popcount_avx2(const uint64_t* data, std::size_t count) noexcept {
+        auto sum = _mm256_setzero_si256();
+        std::size_t index = 0;
+        for(; index + 4 <= count; index += 4){
+            auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index));
+            sum = _mm256_add_epi64(sum, popcount_avx2_vector(a));
+        }
+        return horizontal_sum_avx2(sum) + popcount_scalar(data + index, count - index);
+    }
+
+    template<operation Op>
+    __attribute__((target("avx2"))) std::size_t combine_count_avx2(const uint64_t* lhs, const uint64_t* rhs, std::size_t count) noexcept {
+        auto sum = _mm256_setzero_si256();
+        std::size_t index = 0;
+        for(; index + 4 <= count; index += 4){
+            auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + index));
+            auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + index));
+            sum = _mm256_add_epi64(sum, popcount_avx2_vector(combine_avx2_vector<Op>(a, b)));
+        }
+        return horizontal_sum_avx2(sum) + combine_count_scalar<Op>(lhs + index, rhs + index, count - index);
+    }
+
+    template<operation Op>
+    __attribute__((target("avx512f,avx512bw"))) inline __m512i combine_avx512_vector(__m512i lhs, __m512i rhs) noexcept {
+        switch(Op){
+            case operation::intersection: return _mm512_and_si512(lhs, rhs);
+            case operation::union_: return _mm512_or_si512(lhs, rhs);
+            // lhs & ~rhs as a ternary truth table, _mm512_andnot_si512 trips the same header warning as the reduction
+            case operation::difference: return _mm512_ternarylogic_epi64(lhs, rhs, rhs, 0x30);
+            case operation::symmetric_difference: return _mm512_xor_si512(lhs, rhs);
+        }
+        return lhs;
+    }
+
+    /// Same nibble lookup as the AVX2 variant, VPOPCNTQ isn't available on most AVX-512 CPUs
+    __attribute__((target("avx512f,avx512bw"))) inline __m512i popcount_avx512_vector(__m512i data) noexcept {
+        const auto table = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+        const auto low_mask = _mm512_set1_epi8(0x0f);
+        auto low = _mm512_and_si512(data, low_mask);
+        auto high = _mm512_and_si512(_mm512_srli_epi16(data, 4), low_mask);
+        auto bytes = _mm512_add_epi8(_mm512_shuffle_epi8(table, low), _mm512_shuffle_epi8(table, high));
+        return _mm512_sad_epu8(bytes, _mm512_setzero_si512());
+    }
+
+    /// Lanes are summed through memory, _mm512_reduce_add_epi64 trips uninitialized warnings in GCC 12 headers
+    __attribute__((target("avx512f"))) inline std::size_t horizontal_sum_avx512(__m512i data) noexcept {
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512(lanes, data);
+        std::size_t result = 0;
+        for(auto lane: lanes){
+            result += lane;
+        }
+        return result;
+    }
+
+    template<operation Op>
+    __attribute__((target("avx512f,avx512bw"))) void combine_avx512(uint64_t* result, const uint64_t* lhs, const uint64_t* rhs, std::size_t count) noexcept {
+        std::size_t index = 0;
+        for(; index + 8 <= count; index += 8){
+            auto a = _mm512_loadu_si512(lhs + index);
+            auto b = _mm512_loadu_si512(rhs + index);
+            _mm512_storeu_si512(result + index, combine_avx512_vector<Op>(a, b));
+        }
+        combine_scalar<Op>(result + index, lhs + index, rhs + index, count - index);
+    }
+
+    __attribute__((target("avx512f,avx512bw"))) inline std::size_t popcount_avx512(const uint64_t* data, std::size_t count) noexcept {
+        auto sum = _mm512_setzero_si512();
+        std::size_t index = 0;
+        for(; index + 8 <= count; index += 8){
+            sum = _mm512_add_epi64(sum, popcount_avx512_vector(_mm512_loadu_si512(data + index)));
+        }
+        return horizontal_sum_avx512(sum) + popcount_scalar(data + index, count - index);
+    }
+
+    template<operation Op>
+    __attribute__((target("avx512f,avx512bw"))) std::size_t combine_count_avx512(const uint64_t* lhs, const uint64_t* rhs, std::size_t count) noexcept {
+        auto sum = _mm512_setzero_si512();
+        std::size_t index = 0;
+        for(; index + 8 <= count; index += 8){
+            auto a = _mm512_loadu_si512(lhs + index);
+            auto b = _mm512_loadu_si512(rhs + index);
+            sum = _mm512_add_epi64(sum, popcount_avx512_vector(combine_avx512_vector<Op>(a, b)));
+        }
+        return horizontal_sum_avx512(sum) + combine_count_scalar<Op>(lhs + index, rhs + index, count - index);
+    }
+#endif
+
+    /// result[i] = lhs[i] Op rhs[i], result may alias lhs
+    template<operation Op>
+    void combine(uint64_t* result, const uint64_t* lhs, const uint64_t* rhs, std::size_t count) noexcept {
+        switch(active_simd()){
+#ifdef HW4_X86_KERNELS
+            case simd::avx512: return combine_avx512<Op>(result, lhs, rhs, count);
+            case simd::avx2: return combine_avx2<Op>(result, lhs, rhs, count);
+#endif
+            default: return combine_scalar<Op>(result, lhs, rhs, count);
+        }
+    }
+
+    /// Number of set bits in data
+    inline std::size_t popcount(const uint64_t* data, std::size_t count) noexcept {
+        switch(active_simd()){
+#ifdef HW4_X86_KERNELS
+            case simd::avx512: return popcount_avx512(data, count);
+            case simd::avx2: return popcount_avx2(data, count);
+#endif
+            default: return popcount_scalar(data, count);
+        }
+    }
+
+    /// Number of set bits in lhs Op rhs, without storing it anywhere
+    template<operation Op>
+    std::size_t combine_count(const uint64_t* lhs, const uint64_t* rhs, std::size_t count) noexcept {
+        switch(active_simd()){
+#ifdef HW4_X86_KERNELS
+            case simd::avx512: return combine_count_avx512<Op>(lhs, rhs, count);
+            case simd::avx2: return combine_count_avx2<Op>(lhs, rhs, count);
+#endif
+            default: return combine_count_scalar<Op>(lhs, rhs, count);
+        }
+    }
+}
+
+#endif //HW4_BITVECTOR_KERNELS_HH
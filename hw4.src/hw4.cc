@@ -4,6 +4,10 @@
 #include <brick-benchmark>
 #include "int16_set_trie.hh"
 #include "int16_set_bitvector.hh"
+#include "int16_set_hybrid.hh"
+
+#include <type_traits>
+#include <vector>
 
 using namespace brick;
 
@@ -16,6 +20,11 @@ struct Set : benchmark::Group
     int16_set_trie set_trie;
     int16_set_trie set_trie2;
     int16_set_trie set_trie3;
+    int16_set_hybrid set_hybrid;
+    int16_set_hybrid set_hybrid2;
+    int16_set_hybrid set_hybrid3;
+    std::vector<uint16_t> values;
+    std::vector<uint8_t> found;
     Set()
     {
         x.type = benchmark::Axis::Quantitative;
@@ -28,14 +37,16 @@ struct Set : benchmark::Group
         y.type = benchmark::Axis::Qualitative;
         y.name = "implementation";
         y.min = 1;
-        y.max = 2;
+        y.max = 3;
         y._render = []( int i )
         {
             switch ( i )
             {
                 case 1: return "trie";
                 case 2: return "bitfield";
+                case 3: return "hybrid";
             }
+            return "";
         };
 
 
@@ -62,11 +73,32 @@ struct Set : benchmark::Group
                 break;
             case 2:
                 set_bitvector = int16_set_bitvector{};
-                insert_func(set_trie);
+                insert_func(set_bitvector);
 
                 set_bitvector2 = int16_set_bitvector{};
                 insert_func(set_bitvector2);
                 break;
+            case 3:
+                set_hybrid = int16_set_hybrid{};
+                insert_func(set_hybrid);
+
+                set_hybrid2 = int16_set_hybrid{};
+                insert_func(set_hybrid2);
+                break;
+        }
+
+        // In-place benchmarks modify the third set, repeating |= or &= with the same operand changes nothing
+        set_trie3 = set_trie;
+        set_bitvector3 = set_bitvector;
+        set_hybrid3 = set_hybrid;
+
+        // Bulk benchmarks take the same random values as insert and contains, only generated up front,
+        // so the generator starts from the seed those benchmarks get below
+        values.resize(p);
+        found.resize(p);
+        rng.seed(0);
+        for(auto& value: values){
+            value = rng();
         }
 
         rng.seed(0);
@@ -82,6 +114,7 @@ struct Set : benchmark::Group
         {
             case 1: insert<int16_set_trie>(); break;
             case 2: insert<int16_set_bitvector>(); break;
+            case 3: insert<int16_set_hybrid>(); break;
         }
     }
 
@@ -93,12 +126,51 @@ struct Set : benchmark::Group
         }
     }
 
+    BENCHMARK(insertmany)
+    {
+        switch ( q )
+        {
+            case 1: insertmany<int16_set_trie>(); break;
+            case 2: insertmany<int16_set_bitvector>(); break;
+            // Hybrid set has no bulk insert, this is the one-by-one baseline
+            case 3: insertmany<int16_set_hybrid>(); break;
+        }
+    }
+
+    template <typename Set>
+    void insertmany(){
+        Set set;
+        if constexpr (std::is_same_v<Set, int16_set_hybrid>){
+            for(auto value: values){
+                set.insert(value);
+            }
+        }
+        else{
+            set.insert_many(values.data(), values.size());
+        }
+    }
+
+    BENCHMARK(containsmany)
+    {
+        switch ( q )
+        {
+            case 1: set_trie.contains_many(values.data(), values.size(), found.data()); break;
+            case 2: set_bitvector.contains_many(values.data(), values.size(), found.data()); break;
+            case 3:
+                for(std::size_t i = 0; i < values.size(); ++i){
+                    found[i] = set_hybrid.contains(values[i]);
+                }
+                break;
+        }
+    }
+
     BENCHMARK(contains)
     {
         switch ( q )
         {
             case 1: contains(set_trie); break;
             case 2: contains(set_bitvector); break;
+            case 3: contains(set_hybrid); break;
         }
     }
 
@@ -114,6 +186,7 @@ struct Set : benchmark::Group
         {
             case 1: unionbench(set_trie3, set_trie, set_trie2); break;
             case 2: unionbench(set_bitvector3, set_bitvector, set_bitvector2); break;
+            case 3: unionbench(set_hybrid3, set_hybrid, set_hybrid2); break;
         }
     }
 
@@ -123,4 +196,56 @@ struct Set : benchmark::Group
         target_set = set | set2;
 
    }
+
+    BENCHMARK(intersectionbench){
+        switch ( q )
+        {
+            case 1: intersectionbench(set_trie3, set_trie, set_trie2); break;
+            case 2: intersectionbench(set_bitvector3, set_bitvector, set_bitvector2); break;
+            case 3: intersectionbench(set_hybrid3, set_hybrid, set_hybrid2); break;
+        }
+    }
+
+    template <typename Set>
+    void intersectionbench(Set& target_set, const Set& set, const Set& set2){
+        target_set = set & set2;
+    }
+
+    BENCHMARK(unionassign){
+        switch ( q )
+        {
+            case 1: set_trie3 |= set_trie2; break;
+            case 2: set_bitvector3 |= set_bitvector2; break;
+            case 3: set_hybrid3 |= set_hybrid2; break;
+        }
+    }
+
+    BENCHMARK(intersectionassign){
+        switch ( q )
+        {
+            case 1: set_trie3 &= set_trie2; break;
+            case 2: set_bitvector3 &= set_bitvector2; break;
+            case 3: set_hybrid3 &= set_hybrid2; break;
+        }
+    }
+
+    BENCHMARK(erase)
+    {
+        switch ( q )
+        {
+            case 1: erase(set_trie3, set_trie); break;
+            case 2: erase(set_bitvector3, set_bitvector); break;
+            case 3: erase(set_hybrid3, set_hybrid); break;
+        }
+    }
+
+    /// Erases values inserted in setup from a fresh copy, so every run empties the whole set
+    template <typename Set>
+    void erase(Set& target_set, const Set& set){
+        target_set = set;
+        std::mt19937 inserted{0};
+        for(int i = 0; i < p / 2; ++i){
+            target_set.erase(inserted());
+        }
+    }
 };
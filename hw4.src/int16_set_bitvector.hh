@@ -1,8 +1,15 @@
 #ifndef HW4_INT16_SET_BITVECTOR_HH
 #define HW4_INT16_SET_BITVECTOR_HH
 
+#include "bitvector_kernels.hh"
+
+#include <algorithm>
 #include <array>
 #include <climits>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <vector>
 
 namespace detail {
     template<typename BaseType, typename ExpType>
@@ -22,38 +29,307 @@ class int16_set_bitvector {
     using UnderlyingType = uint64_t;
     constexpr static auto bits_per_bucket = sizeof(UnderlyingType) * CHAR_BIT;
     constexpr static auto bucket_count = possible_value_count / bits_per_bucket;
+    using operation = detail::bitvector_kernels::operation;
+    /// Rank index keeps one count per cache line of buckets
+    constexpr static std::size_t buckets_per_block = 8;
+    constexpr static auto block_count = bucket_count / buckets_per_block;
 public:
+    /// Iterates values in ascending order, skipping empty buckets and jumping to next set bit with ctz
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = uint16_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint16_t*;
+        using reference = uint16_t;
+
+        uint16_t operator*() const {
+            return static_cast<uint16_t>(m_bucket * bits_per_bucket + __builtin_ctzll(m_remaining));
+        }
+
+        const_iterator& operator++(){
+            m_remaining &= m_remaining - 1;
+            skip_empty();
+            return *this;
+        }
+
+        const_iterator operator++(int){
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& rhs) const {
+            return m_bucket == rhs.m_bucket && m_remaining == rhs.m_remaining;
+        }
+
+        bool operator!=(const const_iterator& rhs) const {
+            return !(*this == rhs);
+        }
+
+    private:
+        friend class int16_set_bitvector;
+
+        const int16_set_bitvector* m_set;
+        std::size_t m_bucket;
+        /// Bits of current bucket which weren't visited yet
+        UnderlyingType m_remaining;
+
+        const_iterator(const int16_set_bitvector* set, std::size_t bucket) : m_set{set}, m_bucket{bucket},
+            m_remaining{bucket < bucket_count ? set->m_data[bucket] : 0} {
+            skip_empty();
+        }
+
+        void skip_empty(){
+            while(!m_remaining && m_bucket < bucket_count){
+                ++m_bucket;
+                m_remaining = m_bucket < bucket_count ? m_set->m_data[m_bucket] : 0;
+            }
+        }
+    };
+
+    const_iterator begin() const {
+        return {this, 0};
+    }
+
+    const_iterator end() const {
+        return {this, bucket_count};
+    }
+
     void insert(ValueType value){
-        m_data[value / bits_per_bucket] |= 1 << (value % bits_per_bucket);
+        m_data[value / bits_per_bucket] |= UnderlyingType{1} << (value % bits_per_bucket);
     }
     void erase(ValueType value){
-        m_data[value / bits_per_bucket] &= ~(1 << (value % bits_per_bucket));
+        m_data[value / bits_per_bucket] &= ~(UnderlyingType{1} << (value % bits_per_bucket));
     }
     bool contains(ValueType value) const {
-        return static_cast<bool>(m_data[value / bits_per_bucket] & (1 << (value % bits_per_bucket)));
+        return static_cast<bool>(m_data[value / bits_per_bucket] & (UnderlyingType{1} << (value % bits_per_bucket)));
     }
 
-    int16_set_bitvector operator&(const int16_set_bitvector& rhs) const {
-        int16_set_bitvector result;
+    /// Inserts count values
+    /// Bits of the current bucket are collected in a register, the bucket is loaded from memory only
+    /// when a value falls into another one, so runs of sorted input don't wait on their own stores
+    void insert_many(const ValueType* values, std::size_t count){
+        std::size_t current = 0;
+        auto mask = m_data[current];
+        for(std::size_t index = 0; index < count; ++index){
+            std::size_t bucket = values[index] / bits_per_bucket;
+            // Plain conditional, compilers turn it into a conditional move
+            mask = (bucket == current ? mask : m_data[bucket]) | UnderlyingType{1} << (values[index] % bits_per_bucket);
+            m_data[bucket] = mask;
+            current = bucket;
+        }
+    }
 
-        for(std::size_t index = 0; index < bucket_count; ++index){
-            result.m_data[index] = m_data[index] & rhs.m_data[index];
+    /// out[i] is 1 if values[i] is in set and 0 otherwise, without branching on the result
+    void contains_many(const ValueType* values, std::size_t count, uint8_t* out) const {
+        for(std::size_t index = 0; index < count; ++index){
+            out[index] = static_cast<uint8_t>((m_data[values[index] / bits_per_bucket] >> (values[index] % bits_per_bucket)) & 1);
         }
+    }
 
-        return result;
+    std::size_t size() const {
+        return detail::bitvector_kernels::popcount(m_data.data(), bucket_count);
+    }
+
+    /// Number of values in set less than or equal to value
+    /// Buckets before the one holding value are counted by the vectorized popcount, at most 8 KiB are read
+    std::size_t rank(ValueType value) const {
+        auto last_bucket = value / bits_per_bucket;
+        return detail::bitvector_kernels::popcount(m_data.data(), last_bucket) + rank_in_bucket(value);
+    }
+
+    /// k-th smallest value counting from zero, k has to be less than size()
+    /// Skips whole blocks of buckets first, for many queries on an unchanged set build_rank_index is faster
+    ValueType select(std::size_t k) const {
+        std::size_t index = 0;
+        for(std::size_t count; (count = block_popcount(index)) <= k; index += buckets_per_block){
+            k -= count;
+        }
+        return select_from(index, k);
+    }
+
+    /// Counts of values before every block of buckets, answers rank and select by reading at most one block
+    /// Refers to the set it was built from and is valid until that set is changed, like an iterator
+    class rank_index {
+    public:
+        std::size_t rank(ValueType value) const {
+            auto last_bucket = value / bits_per_bucket;
+            auto first_bucket = last_bucket / buckets_per_block * buckets_per_block;
+            std::size_t result = m_counts[last_bucket / buckets_per_block];
+            for(auto index = first_bucket; index < last_bucket; ++index){
+                result += __builtin_popcountll(m_set->m_data[index]);
+            }
+            return result + m_set->rank_in_bucket(value);
+        }
+
+        ValueType select(std::size_t k) const {
+            // Last block with fewer than k + 1 values before it
+            auto block = std::upper_bound(m_counts.begin(), m_counts.end(), k) - m_counts.begin() - 1;
+            return m_set->select_from(block * buckets_per_block, k - m_counts[block]);
+        }
+
+    private:
+        friend class int16_set_bitvector;
+
+        const int16_set_bitvector* m_set;
+        /// Number of values in blocks before the given one, the largest is 65024, so 16 bits are enough
+        std::array<uint16_t, block_count> m_counts;
+
+        explicit rank_index(const int16_set_bitvector* set) : m_set{set} {
+            std::size_t count = 0;
+            for(std::size_t block = 0; block < block_count; ++block){
+                m_counts[block] = static_cast<uint16_t>(count);
+                count += set->block_popcount(block * buckets_per_block);
+            }
+        }
+    };
+
+    rank_index build_rank_index() const {
+        return rank_index{this};
+    }
+
+    /// Smallest value, set must not be empty
+    ValueType min() const {
+        return *begin();
+    }
+
+    /// Largest value, set must not be empty
+    ValueType max() const {
+        auto index = bucket_count - 1;
+        while(!m_data[index]){
+            --index;
+        }
+        return static_cast<ValueType>(index * bits_per_bucket + bits_per_bucket - 1 - __builtin_clzll(m_data[index]));
+    }
+
+    int16_set_bitvector operator&(const int16_set_bitvector& rhs) const {
+        return combined<operation::intersection>(rhs);
     }
     int16_set_bitvector operator|(const int16_set_bitvector& rhs) const {
+        return combined<operation::union_>(rhs);
+    }
+    /// Values of this set which aren't in rhs
+    int16_set_bitvector operator-(const int16_set_bitvector& rhs) const {
+        return combined<operation::difference>(rhs);
+    }
+    int16_set_bitvector operator^(const int16_set_bitvector& rhs) const {
+        return combined<operation::symmetric_difference>(rhs);
+    }
+
+    int16_set_bitvector& operator&=(const int16_set_bitvector& rhs){
+        return combine_with<operation::intersection>(rhs);
+    }
+    int16_set_bitvector& operator|=(const int16_set_bitvector& rhs){
+        return combine_with<operation::union_>(rhs);
+    }
+    int16_set_bitvector& operator-=(const int16_set_bitvector& rhs){
+        return combine_with<operation::difference>(rhs);
+    }
+    int16_set_bitvector& operator^=(const int16_set_bitvector& rhs){
+        return combine_with<operation::symmetric_difference>(rhs);
+    }
+
+    /// Union of count sets in one pass, each block of buckets is combined from all sets while it stays in cache
+    /// Large unions may split blocks among threads, each writes its own part of the result
+    static int16_set_bitvector union_all(const int16_set_bitvector* const* sets, std::size_t count, std::size_t threads = 1){
+        return combined_all<operation::union_>(sets, count, threads);
+    }
+
+    /// Intersection of count sets in one pass, a block stops being combined once it goes empty
+    /// Intersection of no sets is the empty set
+    static int16_set_bitvector intersect_all(const int16_set_bitvector* const* sets, std::size_t count, std::size_t threads = 1){
+        return combined_all<operation::intersection>(sets, count, threads);
+    }
+
+    /// Size of intersection, computed without materializing it
+    std::size_t intersection_count(const int16_set_bitvector& rhs) const {
+        return detail::bitvector_kernels::combine_count<operation::intersection>(m_data.data(), rhs.m_data.data(), bucket_count);
+    }
+    std::size_t union_count(const int16_set_bitvector& rhs) const {
+        return detail::bitvector_kernels::combine_count<operation::union_>(m_data.data(), rhs.m_data.data(), bucket_count);
+    }
+    std::size_t difference_count(const int16_set_bitvector& rhs) const {
+        return detail::bitvector_kernels::combine_count<operation::difference>(m_data.data(), rhs.m_data.data(), bucket_count);
+    }
+
+private:
+    alignas(64) std::array<uint64_t, bucket_count> m_data{};
+
+    std::size_t block_popcount(std::size_t first_bucket) const {
+        return detail::bitvector_kernels::popcount_scalar(m_data.data() + first_bucket, buckets_per_block);
+    }
+
+    /// Values in the bucket of value which are less than or equal to it
+    std::size_t rank_in_bucket(ValueType value) const {
+        auto bit = value % bits_per_bucket;
+        auto mask = bit == bits_per_bucket - 1 ? ~UnderlyingType{0} : (UnderlyingType{1} << (bit + 1)) - 1;
+        return __builtin_popcountll(m_data[value / bits_per_bucket] & mask);
+    }
+
+    /// k-th smallest value counting from bucket index on, there have to be more than k values from there on
+    ValueType select_from(std::size_t index, std::size_t k) const {
+        for(std::size_t count = __builtin_popcountll(m_data[index]); count <= k; count = __builtin_popcountll(m_data[index])){
+            k -= count;
+            ++index;
+        }
+        auto bucket = m_data[index];
+        for(; k > 0; --k){
+            bucket &= bucket - 1;
+        }
+        return static_cast<ValueType>(index * bits_per_bucket + __builtin_ctzll(bucket));
+    }
+
+    template<operation Op>
+    int16_set_bitvector combined(const int16_set_bitvector& rhs) const {
         int16_set_bitvector result;
+        detail::bitvector_kernels::combine<Op>(result.m_data.data(), m_data.data(), rhs.m_data.data(), bucket_count);
+        return result;
+    }
+
+    /// Buckets combined from all sets at once by combined_all, 512 B of every set
+    /// Small blocks let intersections skip more, the result block stays in L1 anyway
+    constexpr static std::size_t all_block_size = 64;
 
-        for(std::size_t index = 0; index < bucket_count; ++index){
-            result.m_data[index] = m_data[index] | rhs.m_data[index];
+    template<operation Op>
+    static int16_set_bitvector combined_all(const int16_set_bitvector* const* sets, std::size_t count, std::size_t threads){
+        int16_set_bitvector result;
+        if(count == 0){
+            return result;
         }
+        auto combine_blocks = [&result, sets, count](std::size_t first, std::size_t last){
+            for(auto bucket = first; bucket < last; bucket += all_block_size){
+                auto block = std::min(all_block_size, last - bucket);
+                auto* out = result.m_data.data() + bucket;
+                std::copy(sets[0]->m_data.data() + bucket, sets[0]->m_data.data() + bucket + block, out);
+                for(std::size_t index = 1; index < count; ++index){
+                    if(Op == operation::intersection && std::all_of(out, out + block, [](UnderlyingType bits){ return !bits; })){
+                        break;
+                    }
+                    detail::bitvector_kernels::combine<Op>(out, out, sets[index]->m_data.data() + bucket, block);
+                }
+            }
+        };
 
+        // Every thread gets whole cache lines, so no two threads write to the same line
+        threads = std::max<std::size_t>(1, std::min(threads, bucket_count / buckets_per_block));
+        auto per_thread = (bucket_count / buckets_per_block + threads - 1) / threads * buckets_per_block;
+        std::vector<std::thread> workers;
+        for(std::size_t first = per_thread; first < bucket_count; first += per_thread){
+            workers.emplace_back(combine_blocks, first, std::min(bucket_count, first + per_thread));
+        }
+        combine_blocks(0, std::min(bucket_count, per_thread));
+        for(auto& worker: workers){
+            worker.join();
+        }
         return result;
     }
 
-private:
-    std::array<uint64_t, bucket_count> m_data{};
+    template<operation Op>
+    int16_set_bitvector& combine_with(const int16_set_bitvector& rhs){
+        detail::bitvector_kernels::combine<Op>(m_data.data(), m_data.data(), rhs.m_data.data(), bucket_count);
+        return *this;
+    }
 };
 
 #endif //HW4_INT16_SET_BITVECTOR_HH
@@ -0,0 +1,380 @@
+#ifndef HW4_INT16_SET_HYBRID_HH
+#define HW4_INT16_SET_HYBRID_HH
+
+#include "int16_set_bitvector.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <variant>
+#include <vector>
+
+namespace detail {
+    /// Values start, start + 1, ..., start + length
+    struct run {
+        uint16_t start;
+        uint16_t length;
+
+        uint32_t last() const {
+            return uint32_t{start} + length;
+        }
+    };
+
+    /// Bitvector lives on the heap, so sparse sets don't pay for its 8 KiB
+    class bitmap_container {
+    public:
+        bitmap_container() : bits{std::make_unique<int16_set_bitvector>()} {}
+        explicit bitmap_container(const int16_set_bitvector& rhs) : bits{std::make_unique<int16_set_bitvector>(rhs)} {}
+        bitmap_container(const bitmap_container& rhs) : bitmap_container(*rhs.bits) {}
+        bitmap_container(bitmap_container&& rhs) noexcept = default;
+        bitmap_container& operator=(const bitmap_container& rhs){
+            bits = std::make_unique<int16_set_bitvector>(*rhs.bits);
+            return *this;
+        }
+        bitmap_container& operator=(bitmap_container&& rhs) noexcept = default;
+
+        std::unique_ptr<int16_set_bitvector> bits;
+    };
+}
+
+/// Set of 16-bit values choosing its representation by content, like containers of Roaring bitmaps:
+/// sorted array for sparse sets, bitvector for dense ones and runs of consecutive values
+class int16_set_hybrid {
+public:
+    enum class container { array, bitmap, runs };
+
+    /// Sorted array is used up to this many values, it would take more memory than bitvector then
+    constexpr static std::size_t array_max_size = 4096;
+    /// Bitvector switches back to array only below this many values, so a set alternating
+    /// insert and erase at the array limit doesn't convert its container on every operation
+    constexpr static std::size_t bitmap_min_size = array_max_size / 2;
+
+    void insert(uint16_t value){
+        std::visit([this, value](auto& data){ insert_into(data, value); }, m_data);
+    }
+
+    void erase(uint16_t value){
+        std::visit([this, value](auto& data){ erase_from(data, value); }, m_data);
+    }
+
+    bool contains(uint16_t value) const {
+        return std::visit([value](const auto& data){ return contains_in(data, value); }, m_data);
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+    /// Number of values in set less than or equal to value
+    std::size_t rank(uint16_t value) const {
+        if(auto array = std::get_if<array_container>(&m_data)){
+            return std::upper_bound(array->begin(), array->end(), value) - array->begin();
+        }
+        if(auto bitmap = std::get_if<bitmap_container>(&m_data)){
+            return bitmap->bits->rank(value);
+        }
+        std::size_t result = 0;
+        for(auto run: std::get<run_container>(m_data)){
+            if(run.start > value){
+                break;
+            }
+            result += std::min<uint32_t>(run.last(), value) - run.start + 1;
+        }
+        return result;
+    }
+
+    container kind() const {
+        return static_cast<container>(m_data.index());
+    }
+
+    /// Approximate number of bytes used by the set
+    std::size_t memory_size() const {
+        std::size_t heap = 0;
+        if(auto array = std::get_if<array_container>(&m_data)){
+            heap = array->capacity() * sizeof(uint16_t);
+        }
+        if(std::holds_alternative<bitmap_container>(m_data)){
+            heap = sizeof(int16_set_bitvector);
+        }
+        if(auto runs = std::get_if<run_container>(&m_data)){
+            heap = runs->capacity() * sizeof(detail::run);
+        }
+        return sizeof(*this) + heap;
+    }
+
+    /// Switches to the smallest representation, this is the only way to get runs
+    /// Sets with runs switch back on their own once runs stop paying off
+    void optimize(){
+        auto run_count = count_runs();
+        auto run_bytes = run_count * sizeof(detail::run);
+        if(run_bytes < std::min(m_size * sizeof(uint16_t), sizeof(int16_set_bitvector))){
+            if(!std::holds_alternative<run_container>(m_data)){
+                m_data = to_runs(run_count);
+            }
+            return;
+        }
+        if(m_size <= array_max_size){
+            if(!std::holds_alternative<array_container>(m_data)){
+                m_data = to_array();
+            }
+            return;
+        }
+        if(!std::holds_alternative<bitmap_container>(m_data)){
+            m_data = detail::bitmap_container{to_bitvector()};
+        }
+    }
+
+    int16_set_hybrid operator&(const int16_set_hybrid& rhs) const {
+        // Filtering a sorted array keeps it sorted and it is the smallest operand
+        if(auto array = std::get_if<array_container>(&m_data)){
+            int16_set_hybrid result;
+            auto& result_array = std::get<array_container>(result.m_data);
+            for(auto value: *array){
+                if(rhs.contains(value)){
+                    result_array.push_back(value);
+                }
+            }
+            result.m_size = result_array.size();
+            return result;
+        }
+        if(std::holds_alternative<array_container>(rhs.m_data)){
+            return rhs & *this;
+        }
+        return from_bitvector(to_bitvector() & rhs.to_bitvector());
+    }
+
+    int16_set_hybrid operator|(const int16_set_hybrid& rhs) const {
+        auto array = std::get_if<array_container>(&m_data);
+        auto rhs_array = std::get_if<array_container>(&rhs.m_data);
+        if(array && rhs_array){
+            array_container merged;
+            merged.reserve(array->size() + rhs_array->size());
+            std::set_union(array->begin(), array->end(), rhs_array->begin(), rhs_array->end(), std::back_inserter(merged));
+            if(merged.size() <= array_max_size){
+                int16_set_hybrid result;
+                result.m_size = merged.size();
+                result.m_data = std::move(merged);
+                return result;
+            }
+        }
+        return from_bitvector(to_bitvector() | rhs.to_bitvector());
+    }
+
+    int16_set_hybrid& operator&=(const int16_set_hybrid& rhs){
+        return *this = *this & rhs;
+    }
+
+    int16_set_hybrid& operator|=(const int16_set_hybrid& rhs){
+        return *this = *this | rhs;
+    }
+
+private:
+    using array_container = std::vector<uint16_t>;
+    using bitmap_container = detail::bitmap_container;
+    using run_container = std::vector<detail::run>;
+
+    /// Order of alternatives matches the container enum
+    std::variant<array_container, bitmap_container, run_container> m_data;
+    std::size_t m_size = 0;
+
+    /// First run starting after value, the run before it is the only one which may contain value
+    template<typename Runs>
+    static auto find_next_run(Runs& runs, uint16_t value){
+        return std::upper_bound(runs.begin(), runs.end(), value, [](uint16_t lhs, const detail::run& rhs){
+            return lhs < rhs.start;
+        });
+    }
+
+    void insert_into(array_container& array, uint16_t value){
+        auto position = std::lower_bound(array.begin(), array.end(), value);
+        if(position != array.end() && *position == value){
+            return;
+        }
+        array.insert(position, value);
+        ++m_size;
+        if(m_size > array_max_size){
+            m_data = bitmap_container{to_bitvector()};
+        }
+    }
+
+    void insert_into(bitmap_container& bitmap, uint16_t value){
+        if(bitmap.bits->contains(value)){
+            return;
+        }
+        bitmap.bits->insert(value);
+        ++m_size;
+    }
+
+    void insert_into(run_container& runs, uint16_t value){
+        auto next = find_next_run(runs, value);
+        if(next != runs.begin()){
+            auto previous = std::prev(next);
+            if(value <= previous->last()){
+                return;
+            }
+            // Extends previous run, which may join it with the next one
+            if(value == previous->last() + 1){
+                ++previous->length;
+                ++m_size;
+                if(next != runs.end() && next->start == value + 1){
+                    previous->length = static_cast<uint16_t>(next->last() - previous->start);
+                    runs.erase(next);
+                }
+                return;
+            }
+        }
+        if(next != runs.end() && next->start == value + 1){
+            --next->start;
+            ++next->length;
+        }
+        else{
+            runs.insert(next, detail::run{value, 0});
+        }
+        ++m_size;
+        shrink_runs_if_worthwhile(runs);
+    }
+
+    void erase_from(array_container& array, uint16_t value){
+        auto position = std::lower_bound(array.begin(), array.end(), value);
+        if(position == array.end() || *position != value){
+            return;
+        }
+        array.erase(position);
+        --m_size;
+    }
+
+    void erase_from(bitmap_container& bitmap, uint16_t value){
+        if(!bitmap.bits->contains(value)){
+            return;
+        }
+        bitmap.bits->erase(value);
+        --m_size;
+        if(m_size < bitmap_min_size){
+            m_data = to_array();
+        }
+    }
+
+    void erase_from(run_container& runs, uint16_t value){
+        auto next = find_next_run(runs, value);
+        if(next == runs.begin()){
+            return;
+        }
+        auto containing = std::prev(next);
+        if(value > containing->last()){
+            return;
+        }
+        --m_size;
+
+        if(containing->length == 0){
+            runs.erase(containing);
+        }
+        else if(value == containing->start){
+            ++containing->start;
+            --containing->length;
+        }
+        else if(value == containing->last()){
+            --containing->length;
+        }
+        else{
+            // Value in the middle splits the run in two
+            detail::run tail{static_cast<uint16_t>(value + 1), static_cast<uint16_t>(containing->last() - value - 1)};
+            containing->length = static_cast<uint16_t>(value - containing->start - 1);
+            runs.insert(next, tail);
+            shrink_runs_if_worthwhile(runs);
+        }
+    }
+
+    static bool contains_in(const array_container& array, uint16_t value){
+        return std::binary_search(array.begin(), array.end(), value);
+    }
+
+    static bool contains_in(const bitmap_container& bitmap, uint16_t value){
+        return bitmap.bits->contains(value);
+    }
+
+    static bool contains_in(const run_container& runs, uint16_t value){
+        auto next = find_next_run(runs, value);
+        return next != runs.begin() && value <= std::prev(next)->last();
+    }
+
+    void shrink_runs_if_worthwhile(const run_container& runs){
+        if(runs.size() * sizeof(detail::run) > std::min(m_size * sizeof(uint16_t), sizeof(int16_set_bitvector))){
+            optimize();
+        }
+    }
+
+    /// Calls function for every value in ascending order
+    template<typename Function>
+    void for_each(Function function) const {
+        if(auto array = std::get_if<array_container>(&m_data)){
+            std::for_each(array->begin(), array->end(), function);
+        }
+        if(auto bitmap = std::get_if<bitmap_container>(&m_data)){
+            std::for_each(bitmap->bits->begin(), bitmap->bits->end(), function);
+        }
+        if(auto runs = std::get_if<run_container>(&m_data)){
+            for(auto run: *runs){
+                for(uint32_t value = run.start; value <= run.last(); ++value){
+                    function(static_cast<uint16_t>(value));
+                }
+            }
+        }
+    }
+
+    std::size_t count_runs() const {
+        if(auto runs = std::get_if<run_container>(&m_data)){
+            return runs->size();
+        }
+        std::size_t result = 0;
+        uint32_t expected = UINT32_MAX;
+        for_each([&result, &expected](uint16_t value){
+            if(value != expected){
+                ++result;
+            }
+            expected = uint32_t{value} + 1;
+        });
+        return result;
+    }
+
+    array_container to_array() const {
+        array_container result;
+        result.reserve(m_size);
+        for_each([&result](uint16_t value){ result.push_back(value); });
+        return result;
+    }
+
+    run_container to_runs(std::size_t run_count) const {
+        run_container result;
+        result.reserve(run_count);
+        for_each([&result](uint16_t value){
+            if(!result.empty() && result.back().last() + 1 == value){
+                ++result.back().length;
+            }
+            else{
+                result.push_back(detail::run{value, 0});
+            }
+        });
+        return result;
+    }
+
+    int16_set_bitvector to_bitvector() const {
+        if(auto bitmap = std::get_if<bitmap_container>(&m_data)){
+            return *bitmap->bits;
+        }
+        int16_set_bitvector result;
+        for_each([&result](uint16_t value){ result.insert(value); });
+        return result;
+    }
+
+    static int16_set_hybrid from_bitvector(const int16_set_bitvector& bits){
+        int16_set_hybrid result;
+        result.m_data = bitmap_container{bits};
+        result.m_size = bits.size();
+        if(result.m_size <= array_max_size){
+            result.m_data = result.to_array();
+        }
+        return result;
+    }
+};
+
+#endif //HW4_INT16_SET_HYBRID_HH
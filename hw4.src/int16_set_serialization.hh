@@ -0,0 +1,290 @@
+#ifndef HW4_INT16_SET_SERIALIZATION_HH
+#define HW4_INT16_SET_SERIALIZATION_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/// Portable serialized form of int16 sets, all numbers are little-endian
+///
+///  offset  size  field
+///       0     1  encoding: 0 array, 1 bitmap, 2 runs
+///       1     3  zero
+///       4     4  entry count: values of array, runs of runs, 8192 bytes of bitmap
+///       8     4  number of values in set
+///      12        entries: sorted uint16 values, bitmap bytes (bit j of byte i is value 8 * i + j)
+///                or runs as uint16 start and uint16 length, covering start ... start + length
+///
+/// Everything is read byte by byte, so views may point anywhere into a buffer, e.g. in the middle of a file
+namespace int16_set_format {
+    enum class encoding : uint8_t { array = 0, bitmap = 1, runs = 2 };
+
+    constexpr std::size_t header_size = 12;
+    constexpr std::size_t bitmap_bytes = 65536 / 8;
+
+    inline uint16_t load_u16(const uint8_t* data){
+        return static_cast<uint16_t>(data[0] | data[1] << 8);
+    }
+
+    inline uint32_t load_u32(const uint8_t* data){
+        return uint32_t{data[0]} | uint32_t{data[1]} << 8 | uint32_t{data[2]} << 16 | uint32_t{data[3]} << 24;
+    }
+
+    /// Compilers turn this into a single load on little-endian machines
+    inline uint64_t load_u64(const uint8_t* data){
+        return uint64_t{load_u32(data)} | uint64_t{load_u32(data + 4)} << 32;
+    }
+
+    inline void store_u16(std::vector<uint8_t>& out, uint16_t value){
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    inline void store_u32(std::vector<uint8_t>& out, uint32_t value){
+        for(int shift = 0; shift < 32; shift += 8){
+            out.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+}
+
+/// Read-only set over a serialized buffer, nothing is copied or decoded up front
+/// Buffer has to outlive the view
+class int16_set_view {
+public:
+    using encoding = int16_set_format::encoding;
+
+    /// Checks header and that the entries fit into size bytes, the buffer may continue after them
+    int16_set_view(const uint8_t* data, std::size_t size) : m_data{data} {
+        using namespace int16_set_format;
+        if(size < header_size){
+            throw std::invalid_argument("int16_set_view: buffer is smaller than header");
+        }
+        if(data[0] > static_cast<uint8_t>(encoding::runs) || data[1] || data[2] || data[3]){
+            throw std::invalid_argument("int16_set_view: unknown encoding");
+        }
+        m_encoding = static_cast<encoding>(data[0]);
+        m_entries = load_u32(data + 4);
+        m_size = load_u32(data + 8);
+        if((m_encoding == encoding::bitmap && m_entries != bitmap_bytes) || (m_encoding == encoding::array && m_entries != m_size) ||
+           m_entries > (size - header_size) / entry_size()){
+            throw std::invalid_argument("int16_set_view: entries don't fit into buffer");
+        }
+    }
+
+    encoding kind() const {
+        return m_encoding;
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+    /// Number of bytes taken by the serialized set, the next one may start right after them
+    std::size_t byte_size() const {
+        return int16_set_format::header_size + m_entries * entry_size();
+    }
+
+    bool contains(uint16_t value) const {
+        using int16_set_format::load_u16;
+        switch(m_encoding){
+            case encoding::array: {
+                std::size_t low = 0, high = m_entries;
+                while(low < high){
+                    auto middle = low + (high - low) / 2;
+                    if(load_u16(entries() + 2 * middle) < value){
+                        low = middle + 1;
+                    }
+                    else{
+                        high = middle;
+                    }
+                }
+                return low < m_entries && load_u16(entries() + 2 * low) == value;
+            }
+            case encoding::bitmap:
+                return (entries()[value / 8] >> (value % 8)) & 1;
+            case encoding::runs: {
+                // First run starting after value, the one before it is the only one which may contain value
+                std::size_t low = 0, high = m_entries;
+                while(low < high){
+                    auto middle = low + (high - low) / 2;
+                    if(load_u16(entries() + 4 * middle) <= value){
+                        low = middle + 1;
+                    }
+                    else{
+                        high = middle;
+                    }
+                }
+                if(low == 0){
+                    return false;
+                }
+                auto run = entries() + 4 * (low - 1);
+                return value <= uint32_t{load_u16(run)} + load_u16(run + 2);
+            }
+        }
+        return false;
+    }
+
+    /// Calls function for every value in ascending order
+    template<typename Function>
+    void for_each(Function function) const {
+        using int16_set_format::load_u16;
+        switch(m_encoding){
+            case encoding::array:
+                for(std::size_t index = 0; index < m_entries; ++index){
+                    function(load_u16(entries() + 2 * index));
+                }
+                break;
+            case encoding::bitmap:
+                for(std::size_t word = 0; word < int16_set_format::bitmap_bytes / 8; ++word){
+                    for(auto bits = int16_set_format::load_u64(entries() + 8 * word); bits; bits &= bits - 1){
+                        function(static_cast<uint16_t>(64 * word + __builtin_ctzll(bits)));
+                    }
+                }
+                break;
+            case encoding::runs:
+                for(std::size_t index = 0; index < m_entries; ++index){
+                    uint32_t start = load_u16(entries() + 4 * index);
+                    uint32_t last = start + load_u16(entries() + 4 * index + 2);
+                    for(auto value = start; value <= last; ++value){
+                        function(static_cast<uint16_t>(value));
+                    }
+                }
+                break;
+        }
+    }
+
+    /// Calls function for every value present in both sets in ascending order
+    /// Two bitmaps are combined word by word, otherwise the smaller set is probed in the other one
+    template<typename Function>
+    void intersect(const int16_set_view& rhs, Function function) const {
+        if(m_encoding == encoding::bitmap && rhs.m_encoding == encoding::bitmap){
+            using int16_set_format::load_u64;
+            for(std::size_t word = 0; word < int16_set_format::bitmap_bytes / 8; ++word){
+                for(auto bits = load_u64(entries() + 8 * word) & load_u64(rhs.entries() + 8 * word); bits; bits &= bits - 1){
+                    function(static_cast<uint16_t>(64 * word + __builtin_ctzll(bits)));
+                }
+            }
+            return;
+        }
+        const auto& smaller = m_size <= rhs.m_size ? *this : rhs;
+        const auto& larger = m_size <= rhs.m_size ? rhs : *this;
+        smaller.for_each([&larger, &function](uint16_t value){
+            if(larger.contains(value)){
+                function(value);
+            }
+        });
+    }
+
+    std::size_t intersection_count(const int16_set_view& rhs) const {
+        if(m_encoding == encoding::bitmap && rhs.m_encoding == encoding::bitmap){
+            using int16_set_format::load_u64;
+            std::size_t result = 0;
+            for(std::size_t word = 0; word < int16_set_format::bitmap_bytes / 8; ++word){
+                result += __builtin_popcountll(load_u64(entries() + 8 * word) & load_u64(rhs.entries() + 8 * word));
+            }
+            return result;
+        }
+        std::size_t result = 0;
+        intersect(rhs, [&result](uint16_t){ ++result; });
+        return result;
+    }
+
+private:
+    const uint8_t* m_data;
+    encoding m_encoding;
+    std::size_t m_entries;
+    std::size_t m_size;
+
+    const uint8_t* entries() const {
+        return m_data + int16_set_format::header_size;
+    }
+
+    std::size_t entry_size() const {
+        switch(m_encoding){
+            case encoding::array: return 2;
+            case encoding::bitmap: return 1;
+            case encoding::runs: return 4;
+        }
+        return 1;
+    }
+};
+
+/// Appends set in the smallest of the three encodings to out, works with any set iterable in ascending order
+template<typename Set>
+void serialize(const Set& set, std::vector<uint8_t>& out){
+    using namespace int16_set_format;
+    std::vector<uint16_t> values(set.begin(), set.end());
+    std::size_t run_count = 0;
+    for(std::size_t index = 0; index < values.size(); ++index){
+        if(index == 0 || values[index] != values[index - 1] + 1){
+            ++run_count;
+        }
+    }
+
+    auto array_bytes = 2 * values.size();
+    auto run_bytes = 4 * run_count;
+    auto kind = encoding::array;
+    if(run_bytes < std::min(array_bytes, bitmap_bytes)){
+        kind = encoding::runs;
+    }
+    else if(bitmap_bytes < array_bytes){
+        kind = encoding::bitmap;
+    }
+
+    out.push_back(static_cast<uint8_t>(kind));
+    out.insert(out.end(), 3, 0);
+    switch(kind){
+        case encoding::array:
+            store_u32(out, static_cast<uint32_t>(values.size()));
+            store_u32(out, static_cast<uint32_t>(values.size()));
+            for(auto value: values){
+                store_u16(out, value);
+            }
+            break;
+        case encoding::bitmap: {
+            store_u32(out, static_cast<uint32_t>(bitmap_bytes));
+            store_u32(out, static_cast<uint32_t>(values.size()));
+            auto bitmap = out.size();
+            out.resize(bitmap + bitmap_bytes);
+            for(auto value: values){
+                out[bitmap + value / 8] |= static_cast<uint8_t>(1 << (value % 8));
+            }
+            break;
+        }
+        case encoding::runs:
+            store_u32(out, static_cast<uint32_t>(run_count));
+            store_u32(out, static_cast<uint32_t>(values.size()));
+            for(std::size_t index = 0; index < values.size();){
+                auto start = index;
+                while(index + 1 < values.size() && values[index + 1] == values[index] + 1){
+                    ++index;
+                }
+                store_u16(out, values[start]);
+                store_u16(out, static_cast<uint16_t>(index - start));
+                ++index;
+            }
+            break;
+    }
+}
+
+template<typename Set>
+std::vector<uint8_t> serialize(const Set& set){
+    std::vector<uint8_t> result;
+    serialize(set, result);
+    return result;
+}
+
+/// Builds set of given type from serialized buffer
+template<typename Set>
+Set deserialize(const int16_set_view& view){
+    std::vector<uint16_t> values;
+    values.reserve(view.size());
+    view.for_each([&values](uint16_t value){ values.push_back(value); });
+    Set result;
+    result.insert_many(values.data(), values.size());
+    return result;
+}
+
+#endif //HW4_INT16_SET_SERIALIZATION_HH
@@ -1,119 +1,597 @@
 #ifndef HW4_INT16_SET_TRIE_HH
 #define HW4_INT16_SET_TRIE_HH
 
-#include <cstdint>
-#include <memory>
-#include <optional>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <iterator>
+#include <vector>
 
 namespace detail {
-    template<unsigned level>
-    class node {
+    /// Inner node of the trie, one child per nibble
+    /// Children are indices into the pool of the level below increased by one, so zero means no child
+    /// 16-bit indices are enough, the deepest inner level has at most 4096 children
+    /// Number of values under every child is kept next to it, a child of the root holds at most 4096 of them
+    struct trie_node {
+        std::array<uint16_t, 16> children{};
+        std::array<uint16_t, 16> counts{};
+    };
+}
+
+/// Trie of nibbles, highest nibble first, with 16-bit bitmask leaves for the lowest nibble
+/// Visiting children in nibble order visits values in ascending order
+/// Nodes of every level live in one vector, so copying the trie copies a few flat arrays
+/// and inserting doesn't allocate once the vectors have grown
+/// Erasing prunes nodes left empty, their slots are reused by later insertions
+/// Counts of values under children make size, rank and select walk one path instead of whole subtrees
+class int16_set_trie {
+    constexpr static std::size_t inner_levels = 3;
+    /// insert_many and contains_many check sortedness of input in blocks of this many values
+    constexpr static std::size_t many_block_size = 64;
+public:
+    /// Walks the trie depth-first, children in nibble order, leaf bits are found with ctz
+    class const_iterator {
     public:
-        node() = default;
-        node(const node& rhs){
-            using std::cbegin, std::cend, std::begin;
-
-            std::transform(
-                cbegin(rhs.children),
-                cend(rhs.children),
-                begin(children),
-                [](const auto& child) {
-                    if(child.get()) {
-                        return std::make_unique<node<level - 1>>(*child);
-                    }
-
-                    return std::unique_ptr<node<level-1>>{};
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = uint16_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint16_t*;
+        using reference = uint16_t;
+
+        uint16_t operator*() const {
+            uint32_t value = 0;
+            for(auto nibble: m_nibbles){
+                value = value << 4 | nibble;
+            }
+            return static_cast<uint16_t>(value << 4 | __builtin_ctz(m_remaining));
+        }
+
+        const_iterator& operator++(){
+            m_remaining &= m_remaining - 1;
+            if(m_remaining){
+                return *this;
+            }
+            for(std::size_t level = inner_levels; level-- > 0;){
+                if(descend(level, m_nibbles[level] + 1)){
+                    return *this;
                 }
-            );
+            }
+            return *this;
         }
 
-        node& operator=(node&& rhs) noexcept = default;
+        const_iterator operator++(int){
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
 
-        bool contains(uint16_t value) const {
-            auto nibble = value & 0xf;
+        /// Every leaf of the trie has a distinct index, all finished iterators are equal
+        bool operator==(const const_iterator& rhs) const {
+            return m_remaining == rhs.m_remaining && (!m_remaining || m_path[inner_levels] == rhs.m_path[inner_levels]);
+        }
 
-            auto& child = children[nibble];
-            if(!child) {
-                return false;
+        bool operator!=(const const_iterator& rhs) const {
+            return !(*this == rhs);
+        }
+
+    private:
+        friend class int16_set_trie;
+
+        const int16_set_trie* m_set;
+        /// Index of the node visited on every level, m_path[inner_levels] is the leaf
+        std::array<std::size_t, inner_levels + 1> m_path{};
+        std::array<uint8_t, inner_levels> m_nibbles{};
+        /// Bits of current leaf which weren't visited yet, zero when the iterator is finished
+        uint16_t m_remaining = 0;
+
+        explicit const_iterator(const int16_set_trie* set) : m_set{set} {}
+
+        /// Moves to the first leaf under child nibble or later children of node on given level
+        bool descend(std::size_t level, std::size_t nibble){
+            for(; nibble < 16; ++nibble){
+                auto child = m_set->m_nodes[level][m_path[level]].children[nibble];
+                if(!child){
+                    continue;
+                }
+                m_nibbles[level] = static_cast<uint8_t>(nibble);
+                m_path[level + 1] = child - 1;
+                if(level + 1 == inner_levels){
+                    m_remaining = m_set->m_leaves[child - 1];
+                    return true;
+                }
+                if(descend(level + 1, 0)){
+                    return true;
+                }
             }
+            return false;
+        }
+    };
+
+    const_iterator begin() const {
+        const_iterator result{this};
+        result.descend(0, 0);
+        return result;
+    }
+
+    const_iterator end() const {
+        return const_iterator{this};
+    }
 
-            return child->contains(value >> 4);
+    void insert(uint16_t value){
+        auto& leaf = m_leaves[find_or_add_leaf(value)];
+        if(!(leaf & leaf_bit(value))){
+            leaf |= leaf_bit(value);
+            add_to_counts(value, 1);
         }
+    }
+
+    bool contains(uint16_t value) const {
+        auto leaf = find_leaf(value);
+        return leaf && (m_leaves[leaf - 1] & leaf_bit(value));
+    }
 
-        void insert(uint16_t value) {
-            auto nibble = value & 0x0f;
+    /// Inserts count values
+    /// Sorted stretches of input walk the trie once per leaf, unsorted ones once per value
+    void insert_many(const uint16_t* values, std::size_t count){
+        for(std::size_t block = 0; block < count; block += many_block_size){
+            auto end = std::min(count, block + many_block_size);
+            if(!std::is_sorted(values + block, values + end)){
+                for(auto index = block; index < end; ++index){
+                    insert(values[index]);
+                }
+                continue;
+            }
+            for(auto index = block; index < end;){
+                auto prefix = leaf_prefix(values[index]);
+                auto first = values[index];
+                auto& leaf = m_leaves[find_or_add_leaf(first)];
+                int before = __builtin_popcount(leaf);
+                for(; index < end && leaf_prefix(values[index]) == prefix; ++index){
+                    leaf |= leaf_bit(values[index]);
+                }
+                add_to_counts(first, __builtin_popcount(leaf) - before);
+            }
+        }
+    }
 
-            auto& child = children[nibble];
+    /// out[i] is 1 if values[i] is in set and 0 otherwise
+    /// Sorted stretches of input walk the trie once per leaf, like insert_many
+    void contains_many(const uint16_t* values, std::size_t count, uint8_t* out) const {
+        for(std::size_t block = 0; block < count; block += many_block_size){
+            auto end = std::min(count, block + many_block_size);
+            if(!std::is_sorted(values + block, values + end)){
+                for(auto index = block; index < end; ++index){
+                    out[index] = contains(values[index]);
+                }
+                continue;
+            }
+            for(auto index = block; index < end;){
+                auto prefix = leaf_prefix(values[index]);
+                auto leaf = find_leaf(values[index]);
+                uint32_t mask = leaf ? m_leaves[leaf - 1] : 0;
+                for(; index < end && leaf_prefix(values[index]) == prefix; ++index){
+                    out[index] = static_cast<uint8_t>((mask >> (values[index] & 0x0f)) & 1);
+                }
+            }
+        }
+    }
 
+    /// Removes value, nodes left without children are returned to free lists of their levels
+    void erase(uint16_t value){
+        std::array<std::size_t, inner_levels + 1> path{};
+        for(std::size_t level = 0; level < inner_levels; ++level){
+            auto child = m_nodes[level][path[level]].children[nibble_of(value, level)];
             if(!child){
-                child = std::make_unique<node<level -1>>();
+                return;
             }
+            path[level + 1] = child - 1;
+        }
 
-            child->insert(value >> 4);
+        auto& leaf = m_leaves[path[inner_levels]];
+        if(!(leaf & leaf_bit(value))){
+            return;
+        }
+        leaf &= static_cast<uint16_t>(~leaf_bit(value));
+        for(std::size_t level = 0; level < inner_levels; ++level){
+            --m_nodes[level][path[level]].counts[nibble_of(value, level)];
+        }
+        if(leaf){
+            return;
+        }
+        release(inner_levels, path[inner_levels]);
+        // Walks up unlinking the empty child, stops at the first node still having children, the root stays
+        for(std::size_t level = inner_levels; level-- > 0;){
+            auto& node = m_nodes[level][path[level]];
+            node.children[nibble_of(value, level)] = 0;
+            if(level == 0 || !is_empty(node)){
+                return;
+            }
+            release(level, path[level]);
         }
+    }
 
-        void operator|=(const node<level>& rhs){
-            for(auto i = 0; i < 16; ++i){
-                auto& child = children[i];
-                auto& rhs_child = rhs.children[i];
+    std::size_t size() const {
+        return count(0, 0);
+    }
 
-                if(!rhs_child){
-                    continue;
+    /// Number of values in set less than or equal to value
+    /// Adds counts of children left of the path to value
+    std::size_t rank(uint16_t value) const {
+        std::size_t result = 0;
+        std::size_t index = 0;
+        for(std::size_t level = 0; level < inner_levels; ++level){
+            const auto& node = m_nodes[level][index];
+            for(std::size_t nibble = 0; nibble < nibble_of(value, level); ++nibble){
+                result += node.counts[nibble];
+            }
+            auto child = node.children[nibble_of(value, level)];
+            if(!child){
+                return result;
+            }
+            index = child - 1;
+        }
+        uint32_t mask = (leaf_bit(value) << 1) - 1;
+        return result + __builtin_popcount(m_leaves[index] & mask);
+    }
+
+    /// k-th smallest value counting from zero, k has to be less than size()
+    uint16_t select(std::size_t k) const {
+        uint32_t value = 0;
+        std::size_t index = 0;
+        for(std::size_t level = 0; level < inner_levels; ++level){
+            const auto& node = m_nodes[level][index];
+            for(std::size_t nibble = 0; nibble < 16; ++nibble){
+                if(k < node.counts[nibble]){
+                    value = value << 4 | nibble;
+                    index = node.children[nibble] - 1;
+                    break;
                 }
+                k -= node.counts[nibble];
+            }
+        }
+        uint32_t leaf = m_leaves[index];
+        for(; k > 0; --k){
+            leaf &= leaf - 1;
+        }
+        return static_cast<uint16_t>(value << 4 | __builtin_ctz(leaf));
+    }
 
-                if(!child){
-                    child = std::make_unique<node<level - 1>>();
+    /// Smallest value, set must not be empty
+    uint16_t min() const {
+        return *begin();
+    }
+
+    /// Largest value, set must not be empty
+    uint16_t max() const {
+        uint32_t value = 0;
+        std::size_t index = 0;
+        for(std::size_t level = 0; level < inner_levels; ++level){
+            const auto& node = m_nodes[level][index];
+            std::size_t nibble = 16;
+            while(!node.children[--nibble]){}
+            value = value << 4 | nibble;
+            index = node.children[nibble] - 1;
+        }
+        return static_cast<uint16_t>(value << 4 | (31 - __builtin_clz(m_leaves[index])));
+    }
+
+    int16_set_trie operator|(const int16_set_trie& rhs) const {
+        // Copying flat pools is cheap, the smaller trie is then merged node by node
+        if(node_count() < rhs.node_count()){
+            return rhs | *this;
+        }
+        int16_set_trie result = *this;
+        result |= rhs;
+        return result;
+    }
+
+    /// Builds only nodes present in both tries, subtrees missing in either one are never visited
+    int16_set_trie operator&(const int16_set_trie& rhs) const {
+        int16_set_trie result;
+        for(std::size_t nibble = 0; nibble < 16; ++nibble){
+            auto child = m_nodes[0][0].children[nibble];
+            auto rhs_child = rhs.m_nodes[0][0].children[nibble];
+            if(child && rhs_child){
+                auto& root = result.m_nodes[0][0];
+                root.children[nibble] = result.intersect(1, *this, child - 1, rhs, rhs_child - 1);
+                if(root.children[nibble]){
+                    root.counts[nibble] = static_cast<uint16_t>(result.count(1, root.children[nibble] - 1));
                 }
+            }
+        }
+        return result;
+    }
+
+    /// Union of count tries in one pass, every node of the result is built once from the nodes of all inputs
+    static int16_set_trie union_all(const int16_set_trie* const* sets, std::size_t count){
+        int16_set_trie result;
+        std::vector<std::pair<const int16_set_trie*, std::size_t>> roots;
+        for(std::size_t index = 0; index < count; ++index){
+            roots.emplace_back(sets[index], 0);
+        }
+        result.combine_all<false>(0, 0, roots);
+        return result;
+    }
+
+    /// Intersection of count tries in one pass, a subtree is left as soon as one input lacks it
+    /// Intersection of no tries is the empty set
+    static int16_set_trie intersect_all(const int16_set_trie* const* sets, std::size_t count){
+        int16_set_trie result;
+        if(count == 0){
+            return result;
+        }
+        std::vector<std::pair<const int16_set_trie*, std::size_t>> roots;
+        for(std::size_t index = 0; index < count; ++index){
+            roots.emplace_back(sets[index], 0);
+        }
+        result.combine_all<true>(0, 0, roots);
+        return result;
+    }
+
+    int16_set_trie& operator|=(const int16_set_trie& rhs){
+        merge(0, 0, rhs, 0);
+        return *this;
+    }
+
+    int16_set_trie& operator&=(const int16_set_trie& rhs){
+        intersect_with(0, 0, rhs, 0);
+        return *this;
+    }
+
+private:
+    /// m_nodes[0] holds just the root, m_nodes[level + 1] holds children of m_nodes[level]
+    std::array<std::vector<detail::trie_node>, inner_levels> m_nodes{{{detail::trie_node{}}, {}, {}}};
+    /// Children of m_nodes[inner_levels - 1], bit i says the lowest nibble i is present
+    std::vector<uint16_t> m_leaves;
+    /// Indices of pruned nodes per level, m_free[inner_levels] holds pruned leaves
+    /// Pools never grow past the number of nodes reachable at their level, so indices fit 16 bits
+    std::array<std::vector<uint16_t>, inner_levels + 1> m_free;
+
+    /// Nibble of value selecting child of node on given level
+    static std::size_t nibble_of(uint16_t value, std::size_t level){
+        return (value >> (4 * (inner_levels - level))) & 0x0f;
+    }
 
-                *child |= *rhs_child;
+    /// Values with the same prefix share a leaf
+    static uint16_t leaf_prefix(uint16_t value){
+        return value >> 4;
+    }
+
+    /// Index of the leaf for value increased by one, zero if the trie has no such leaf
+    std::size_t find_leaf(uint16_t value) const {
+        std::size_t index = 0;
+        for(std::size_t level = 0; level < inner_levels; ++level){
+            auto child = m_nodes[level][index].children[nibble_of(value, level)];
+            if(!child){
+                return 0;
             }
+            index = child - 1;
         }
+        return index + 1;
+    }
 
+    /// Index of the leaf for value, missing nodes on the way are added
+    std::size_t find_or_add_leaf(uint16_t value){
+        std::size_t index = 0;
+        for(std::size_t level = 0; level < inner_levels; ++level){
+            auto& child = m_nodes[level][index].children[nibble_of(value, level)];
+            if(!child){
+                child = static_cast<uint16_t>(add_child(level) + 1);
+            }
+            index = child - 1;
+        }
+        return index;
+    }
 
-    private:
-        std::array<std::unique_ptr<node<level - 1>>, 16> children{};
-    };
+    static uint32_t leaf_bit(uint16_t value){
+        return uint32_t{1} << (value & 0x0f);
+    }
 
-    template<>
-    class node<0> {
-    public:
-        bool contains(uint16_t value) const {
-            return static_cast<bool>(data & (1 << value));
+    /// Number of values in subtree of node or leaf on given level, sum of counts of its children
+    std::size_t count(std::size_t level, std::size_t index) const {
+        if(level == inner_levels){
+            return __builtin_popcount(m_leaves[index]);
+        }
+        std::size_t result = 0;
+        for(auto child_count: m_nodes[level][index].counts){
+            result += child_count;
         }
+        return result;
+    }
 
-        void insert(uint16_t value) {
-            data |= 1 << value;
+    /// Adds delta to counts on the path to value, which has to exist
+    void add_to_counts(uint16_t value, int delta){
+        std::size_t index = 0;
+        for(std::size_t level = 0; level < inner_levels; ++level){
+            auto& node = m_nodes[level][index];
+            auto nibble = nibble_of(value, level);
+            node.counts[nibble] = static_cast<uint16_t>(node.counts[nibble] + delta);
+            index = node.children[nibble] - 1;
         }
+    }
 
-        void operator|=(const node<0>& rhs){
-            data |= rhs.data;
+    static bool is_empty(const detail::trie_node& node){
+        for(auto child: node.children){
+            if(child){
+                return false;
+            }
         }
+        return true;
+    }
 
-    private:
-        uint16_t data = 0;
-    };
-}
+    std::size_t node_count() const {
+        return m_nodes[1].size() + m_nodes[2].size() + m_leaves.size();
+    }
 
-class int16_set_trie {
-public:
+    /// Returns node or leaf at given level to its free list, pruned slots are always left empty
+    void release(std::size_t level, std::size_t index){
+        m_free[level].push_back(static_cast<uint16_t>(index));
+    }
 
-    void insert(uint16_t value){
-        parent.insert(value);
+    /// Returns whole subtree to free lists
+    void release_subtree(std::size_t level, std::size_t index){
+        if(level < inner_levels){
+            auto& node = m_nodes[level][index];
+            for(auto& child: node.children){
+                if(child){
+                    release_subtree(level + 1, child - 1);
+                    child = 0;
+                }
+            }
+            node.counts = {};
+        }
+        else{
+            m_leaves[index] = 0;
+        }
+        release(level, index);
     }
 
-    bool contains(uint16_t value) const {
-        return parent.contains(value);
+    /// Takes empty node from given level, a pruned one if there is any, returns its index
+    std::size_t add_node(std::size_t level){
+        if(!m_free[level].empty()){
+            auto index = m_free[level].back();
+            m_free[level].pop_back();
+            return index;
+        }
+        if(level < inner_levels){
+            m_nodes[level].emplace_back();
+            return m_nodes[level].size() - 1;
+        }
+        m_leaves.push_back(0);
+        return m_leaves.size() - 1;
     }
-    int16_set_trie operator|(const int16_set_trie& rhs) const {
-        int16_set_trie result = *this;
 
-        result.parent |= rhs.parent;
+    /// Adds empty child to the level below given level, returns its index
+    std::size_t add_child(std::size_t level){
+        return add_node(level + 1);
+    }
 
-        return result;
+    /// Adds subtree of rhs at given level and index into our subtree at the same position
+    void merge(std::size_t level, std::size_t index, const int16_set_trie& rhs, std::size_t rhs_index){
+        if(level == inner_levels){
+            m_leaves[index] |= rhs.m_leaves[rhs_index];
+            return;
+        }
+
+        for(std::size_t nibble = 0; nibble < 16; ++nibble){
+            auto rhs_child = rhs.m_nodes[level][rhs_index].children[nibble];
+            if(!rhs_child){
+                continue;
+            }
+            // add_child may reallocate the level below, not this one, so the reference stays valid
+            auto& child = m_nodes[level][index].children[nibble];
+            if(!child){
+                child = static_cast<uint16_t>(add_child(level) + 1);
+            }
+            merge(level + 1, child - 1, rhs, rhs_child - 1);
+            m_nodes[level][index].counts[nibble] = static_cast<uint16_t>(count(level + 1, child - 1));
+        }
+    }
+
+    /// Stores intersection of given subtrees of lhs and rhs into our pools
+    /// Returns index of the new node increased by one, or zero when the intersection is empty
+    uint16_t intersect(std::size_t level, const int16_set_trie& lhs, std::size_t lhs_index,
+                       const int16_set_trie& rhs, std::size_t rhs_index){
+        if(level == inner_levels){
+            uint16_t mask = lhs.m_leaves[lhs_index] & rhs.m_leaves[rhs_index];
+            if(!mask){
+                return 0;
+            }
+            auto index = add_node(level);
+            m_leaves[index] = mask;
+            return static_cast<uint16_t>(index + 1);
+        }
+
+        detail::trie_node node;
+        const auto& lhs_node = lhs.m_nodes[level][lhs_index];
+        const auto& rhs_node = rhs.m_nodes[level][rhs_index];
+        for(std::size_t nibble = 0; nibble < 16; ++nibble){
+            if(lhs_node.children[nibble] && rhs_node.children[nibble]){
+                node.children[nibble] = intersect(level + 1, lhs, lhs_node.children[nibble] - 1,
+                                                  rhs, rhs_node.children[nibble] - 1);
+                if(node.children[nibble]){
+                    node.counts[nibble] = static_cast<uint16_t>(count(level + 1, node.children[nibble] - 1));
+                }
+            }
+        }
+        if(is_empty(node)){
+            return 0;
+        }
+        // Children are added before their parent, which is fine as every level has its own pool
+        auto index = add_node(level);
+        m_nodes[level][index] = node;
+        return static_cast<uint16_t>(index + 1);
+    }
+
+    /// Fills our node or leaf at given level from given nodes of other tries, each pair is a trie and node index
+    /// Returns whether anything was stored, our node is left empty otherwise
+    template<bool Intersection>
+    bool combine_all(std::size_t level, std::size_t index, const std::vector<std::pair<const int16_set_trie*, std::size_t>>& nodes){
+        if(level == inner_levels){
+            uint16_t mask = Intersection ? 0xffff : 0;
+            for(auto [set, node]: nodes){
+                mask = Intersection ? mask & set->m_leaves[node] : mask | set->m_leaves[node];
+            }
+            m_leaves[index] = mask;
+            return mask != 0;
+        }
+
+        bool non_empty = false;
+        std::vector<std::pair<const int16_set_trie*, std::size_t>> children;
+        children.reserve(nodes.size());
+        for(std::size_t nibble = 0; nibble < 16; ++nibble){
+            children.clear();
+            for(auto [set, node]: nodes){
+                auto child = set->m_nodes[level][node].children[nibble];
+                if(child){
+                    children.emplace_back(set, child - 1);
+                }
+                else if(Intersection){
+                    break;
+                }
+            }
+            if(children.empty() || (Intersection && children.size() != nodes.size())){
+                continue;
+            }
+            auto child = add_child(level);
+            if(combine_all<Intersection>(level + 1, child, children)){
+                m_nodes[level][index].children[nibble] = static_cast<uint16_t>(child + 1);
+                m_nodes[level][index].counts[nibble] = static_cast<uint16_t>(count(level + 1, child));
+                non_empty = true;
+            }
+            else{
+                release(level + 1, child);
+            }
+        }
+        return non_empty;
+    }
+
+    /// Keeps only values present in rhs in our subtree, returns whether anything is left in it
+    bool intersect_with(std::size_t level, std::size_t index, const int16_set_trie& rhs, std::size_t rhs_index){
+        if(level == inner_levels){
+            m_leaves[index] &= rhs.m_leaves[rhs_index];
+            return m_leaves[index] != 0;
+        }
+
+        bool non_empty = false;
+        for(std::size_t nibble = 0; nibble < 16; ++nibble){
+            auto child = m_nodes[level][index].children[nibble];
+            if(!child){
+                continue;
+            }
+            auto rhs_child = rhs.m_nodes[level][rhs_index].children[nibble];
+            if(rhs_child && intersect_with(level + 1, child - 1, rhs, rhs_child - 1)){
+                m_nodes[level][index].counts[nibble] = static_cast<uint16_t>(count(level + 1, child - 1));
+                non_empty = true;
+                continue;
+            }
+            release_subtree(level + 1, child - 1);
+            m_nodes[level][index].children[nibble] = 0;
+            m_nodes[level][index].counts[nibble] = 0;
+        }
+        return non_empty;
     }
-private:
-    detail::node<3> parent;
 };
 
 #endif //HW4_INT16_SET_TRIE_HH
@@ -1,8 +1,17 @@
 #include "int16_set_bitvector.hh"
 #include "int16_set_trie.hh"
+#include "int16_set_hybrid.hh"
+#include "int16_set_serialization.hh"
+#include "wide_int_set.hh"
 
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
 
 template<typename Set>
 void test(){
@@ -48,8 +57,543 @@ void test(){
     assert(!set.contains(65534));
 }
 
+void test_hybrid(){
+    using container = int16_set_hybrid::container;
+
+    int16_set_hybrid sparse;
+    for(uint16_t i = 0; i < 100; ++i){
+        sparse.insert(i * 7);
+    }
+    assert(sparse.kind() == container::array);
+    assert(sparse.size() == 100);
+    assert(sparse.memory_size() < sizeof(int16_set_bitvector) / 20);
+
+    // Growing over array limit switches to bitvector, shrinking well below it switches back to array
+    int16_set_hybrid dense;
+    for(uint32_t i = 0; i < 65536; i += 2){
+        dense.insert(i);
+    }
+    assert(dense.kind() == container::bitmap);
+    assert(dense.size() == 32768);
+    for(uint32_t i = 0; i < 65536; ++i){
+        assert(dense.contains(i) == (i % 2 == 0));
+    }
+    for(uint32_t i = 0; i < 60000; i += 2){
+        dense.erase(i);
+    }
+    assert(dense.kind() == container::bitmap);
+    assert(dense.size() == 2768);
+    for(uint32_t i = 60000; i < 62000; i += 2){
+        dense.erase(i);
+    }
+    assert(dense.kind() == container::array);
+    assert(dense.size() == 1768);
+    for(uint32_t i = 0; i < 65536; ++i){
+        assert(dense.contains(i) == (i % 2 == 0 && i >= 62000));
+    }
+
+    // Alternating insert and erase at the array limit keeps the container
+    int16_set_hybrid boundary;
+    for(uint16_t i = 0; i < int16_set_hybrid::array_max_size; ++i){
+        boundary.insert(i);
+    }
+    assert(boundary.kind() == container::array);
+    for(int round = 0; round < 10; ++round){
+        boundary.insert(60000);
+        assert(boundary.kind() == container::bitmap);
+        boundary.erase(60000);
+        assert(boundary.kind() == container::bitmap);
+        assert(boundary.size() == int16_set_hybrid::array_max_size);
+    }
+    for(uint16_t i = int16_set_hybrid::bitmap_min_size; i < int16_set_hybrid::array_max_size; ++i){
+        boundary.erase(i);
+    }
+    assert(boundary.kind() == container::bitmap);
+    assert(boundary.size() == int16_set_hybrid::bitmap_min_size);
+    boundary.erase(0);
+    assert(boundary.kind() == container::array);
+    for(uint32_t i = 0; i < 65536; ++i){
+        assert(boundary.contains(i) == (i > 0 && i < int16_set_hybrid::bitmap_min_size));
+    }
+
+    // Long ranges are stored as runs after optimization
+    int16_set_hybrid ranges;
+    for(uint32_t i = 1000; i < 31000; ++i){
+        ranges.insert(i);
+    }
+    ranges.insert(65535);
+    ranges.optimize();
+    assert(ranges.kind() == container::runs);
+    assert(ranges.size() == 30001);
+    ranges.insert(999);
+    ranges.insert(31000);
+    ranges.insert(65534);
+    ranges.insert(0);
+    ranges.erase(20000);
+    ranges.erase(1000);
+    ranges.erase(65535);
+    assert(ranges.kind() == container::runs);
+    assert(ranges.size() == 30002);
+    for(uint32_t i = 0; i < 65536; ++i){
+        auto expected = i == 0 || (i >= 999 && i <= 31000 && i != 1000 && i != 20000) || i == 65534;
+        assert(ranges.contains(i) == expected);
+    }
+
+    // Fragmenting runs switches back to a cheaper representation
+    for(uint32_t i = 1001; i < 31000; i += 2){
+        ranges.erase(i);
+    }
+    assert(ranges.kind() != container::runs);
+    for(uint32_t i = 1001; i < 31000; ++i){
+        assert(ranges.contains(i) == (i % 2 == 0 && i != 20000));
+    }
+
+    auto sparse_and_dense = sparse & dense;
+    auto dense_and_ranges = dense & ranges;
+    auto sparse_or_dense = sparse | dense;
+    auto ranges_or_sparse = ranges | sparse;
+    for(uint32_t i = 0; i < 65536; ++i){
+        assert(sparse_and_dense.contains(i) == (sparse.contains(i) && dense.contains(i)));
+        assert(dense_and_ranges.contains(i) == (dense.contains(i) && ranges.contains(i)));
+        assert(sparse_or_dense.contains(i) == (sparse.contains(i) || dense.contains(i)));
+        assert(ranges_or_sparse.contains(i) == (ranges.contains(i) || sparse.contains(i)));
+    }
+    assert(ranges_or_sparse.size() == ranges.size() + sparse.size() - (ranges & sparse).size());
+
+    int16_set_hybrid copy = ranges;
+    copy.insert(1);
+    assert(copy.contains(1));
+    assert(!ranges.contains(1));
+}
+
+template<typename Set, typename ValueType>
+void test_wide(){
+    std::mt19937_64 rng{0};
+    std::set<ValueType> reference, reference2;
+    Set set, set2;
+
+    // Mix of values spread over the whole range and values concentrated in a few buckets
+    for(int i = 0; i < 20000; ++i){
+        auto clustered = static_cast<ValueType>(rng() % 200000);
+        set.insert(clustered);
+        reference.insert(clustered);
+        if(i % 8 == 0){
+            auto value = static_cast<ValueType>(rng());
+            set.insert(value);
+            reference.insert(value);
+        }
+        if(i % 3 == 0){
+            set2.insert(clustered);
+            reference2.insert(clustered);
+        }
+    }
+    set.insert(std::numeric_limits<ValueType>::max());
+    reference.insert(std::numeric_limits<ValueType>::max());
+    assert(set.size() == reference.size());
+    for(auto value: reference){
+        assert(set.contains(value));
+    }
+    assert(!set.contains(std::numeric_limits<ValueType>::max() - 1));
+
+    std::size_t rank = 0;
+    for(auto value: reference){
+        ++rank;
+        if(rank % 97 == 0){
+            assert(set.rank(value) == rank);
+        }
+    }
+
+    auto united = set | set2;
+    auto intersected = set & set2;
+    assert(united.size() == reference.size());
+    assert(intersected.size() == reference2.size());
+    for(ValueType value = 0; value < 200000; ++value){
+        assert(united.contains(value) == (reference.count(value) || reference2.count(value)));
+        assert(intersected.contains(value) == (reference.count(value) && reference2.count(value)));
+    }
+
+    set.optimize();
+    for(auto value: reference2){
+        set.erase(value);
+    }
+    assert(set.size() == reference.size() - reference2.size());
+    for(auto value: reference2){
+        assert(!set.contains(value));
+    }
+}
+
+void test_rank(){
+    int16_set_bitvector bitvector;
+    int16_set_hybrid hybrid;
+    for(uint32_t i = 0; i < 65536; i += 3){
+        bitvector.insert(i);
+        hybrid.insert(i);
+    }
+    for(uint32_t i = 0; i < 65536; ++i){
+        assert(bitvector.rank(i) == i / 3 + 1);
+        assert(hybrid.rank(i) == i / 3 + 1);
+    }
+
+    int16_set_hybrid runs;
+    for(uint32_t i = 100; i < 20000; ++i){
+        runs.insert(i);
+    }
+    runs.optimize();
+    assert(runs.rank(99) == 0);
+    assert(runs.rank(100) == 1);
+    assert(runs.rank(19999) == 19900);
+    assert(runs.rank(65535) == 19900);
+
+    // Index answers the same as the set, values are spread unevenly so some blocks are empty
+    std::mt19937 rng{3};
+    int16_set_bitvector sparse;
+    for(int i = 0; i < 2000; ++i){
+        sparse.insert(static_cast<uint16_t>(rng() % 20000 + (i % 2) * 40000));
+    }
+    auto index = sparse.build_rank_index();
+    for(uint32_t i = 0; i < 65536; ++i){
+        assert(index.rank(i) == sparse.rank(i));
+    }
+    for(std::size_t k = 0; k < sparse.size(); ++k){
+        assert(index.select(k) == sparse.select(k));
+        assert(sparse.rank(sparse.select(k)) == k + 1);
+    }
+}
+
+template<typename Set>
+void test_order_statistics(){
+    std::mt19937 rng{2};
+    for(auto count: {1, 10, 3000, 40000}){
+        Set set;
+        std::set<uint16_t> reference;
+        for(int i = 0; i < count; ++i){
+            auto value = static_cast<uint16_t>(rng());
+            set.insert(value);
+            reference.insert(value);
+        }
+        set.insert(0);
+        reference.insert(0);
+        set.insert(65535);
+        reference.insert(65535);
+
+        assert(std::equal(set.begin(), set.end(), reference.begin(), reference.end()));
+        assert(set.min() == 0);
+        assert(set.max() == 65535);
+        set.erase(0);
+        set.erase(65535);
+        reference.erase(0);
+        reference.erase(65535);
+        assert(set.min() == *reference.begin());
+        assert(set.max() == *reference.rbegin());
+        assert(set.size() == reference.size());
+
+        std::size_t k = 0;
+        for(auto value: reference){
+            assert(set.select(k) == value);
+            assert(set.rank(value) == k + 1);
+            assert(value == 0 || set.rank(value - 1) == k);
+            ++k;
+        }
+    }
+
+    Set empty;
+    assert(empty.begin() == empty.end());
+}
+
+template<typename Set>
+void test_many(){
+    std::mt19937 rng{3};
+    std::vector<uint16_t> values;
+    for(int i = 0; i < 5000; ++i){
+        values.push_back(static_cast<uint16_t>(rng()));
+    }
+    // Sorted runs crossing bucket and leaf boundaries, with duplicates
+    for(uint32_t value = 1000; value < 1300; ++value){
+        values.push_back(value);
+        values.push_back(value);
+    }
+
+    Set set, reference;
+    set.insert_many(values.data(), values.size());
+    for(auto value: values){
+        reference.insert(value);
+    }
+    std::vector<uint16_t> all(65536);
+    std::iota(all.begin(), all.end(), 0);
+    std::vector<uint8_t> found(all.size(), 2);
+    set.contains_many(all.data(), all.size(), found.data());
+    for(uint32_t value = 0; value < 65536; ++value){
+        assert(set.contains(value) == reference.contains(value));
+        assert(found[value] == reference.contains(value));
+    }
+
+    set.contains_many(values.data(), values.size(), found.data());
+    assert(std::all_of(found.begin(), found.begin() + values.size(), [](uint8_t f){ return f == 1; }));
+    set.insert_many(values.data(), 0);
+}
+
+template<typename Set>
+void test_serialization(){
+    using encoding = int16_set_view::encoding;
+    std::mt19937 rng{4};
+    Set sparse, dense, runs, empty;
+    for(int i = 0; i < 1000; ++i){
+        sparse.insert(static_cast<uint16_t>(rng()));
+    }
+    for(int i = 0; i < 30000; ++i){
+        dense.insert(static_cast<uint16_t>(rng()));
+    }
+    for(uint32_t value = 100; value < 65536; value += 1000){
+        for(uint32_t i = 0; i < 300; ++i){
+            runs.insert(static_cast<uint16_t>(value + i));
+        }
+    }
+
+    // All sets go to one buffer back to back, views find their ends themselves
+    std::vector<uint8_t> buffer;
+    for(const auto* set: {&sparse, &dense, &runs, &empty}){
+        serialize(*set, buffer);
+    }
+    std::vector<int16_set_view> views;
+    for(std::size_t offset = 0; offset < buffer.size(); offset += views.back().byte_size()){
+        views.emplace_back(buffer.data() + offset, buffer.size() - offset);
+    }
+    assert(views.size() == 4);
+    assert(views[0].kind() == encoding::array);
+    assert(views[1].kind() == encoding::bitmap);
+    assert(views[2].kind() == encoding::runs);
+    assert(views[3].kind() == encoding::array && views[3].size() == 0);
+
+    const Set* sets[] = {&sparse, &dense, &runs, &empty};
+    for(std::size_t index = 0; index < views.size(); ++index){
+        const auto& set = *sets[index];
+        std::vector<uint16_t> iterated;
+        views[index].for_each([&iterated](uint16_t value){ iterated.push_back(value); });
+        assert(std::equal(iterated.begin(), iterated.end(), set.begin(), set.end()));
+        assert(views[index].size() == iterated.size());
+        for(uint32_t value = 0; value < 65536; ++value){
+            assert(views[index].contains(value) == set.contains(value));
+        }
+
+        auto copy = deserialize<Set>(views[index]);
+        assert(std::equal(copy.begin(), copy.end(), set.begin(), set.end()));
+
+        for(std::size_t other = 0; other < views.size(); ++other){
+            std::vector<uint16_t> common;
+            views[index].intersect(views[other], [&common](uint16_t value){ common.push_back(value); });
+            auto expected = set & *sets[other];
+            assert(std::equal(common.begin(), common.end(), expected.begin(), expected.end()));
+            assert(views[index].intersection_count(views[other]) == common.size());
+        }
+    }
+
+    auto expect_invalid = [](const std::vector<uint8_t>& data){
+        try{
+            int16_set_view{data.data(), data.size()};
+            assert(false);
+        }
+        catch(const std::invalid_argument&){}
+    };
+    auto single = serialize(dense);
+    expect_invalid({single.begin(), single.begin() + 11});
+    expect_invalid({single.begin(), single.end() - 1});
+    single[0] = 7;
+    expect_invalid(single);
+}
+
+template<typename Set, typename Function>
+void test_combine_all(Function combine_all){
+    std::mt19937 rng{5};
+    std::vector<Set> sets(40);
+    for(auto& set: sets){
+        // Values cluster in the lower half, so intersections of a few sets aren't empty
+        for(int i = 0; i < 20000; ++i){
+            set.insert(static_cast<uint16_t>(rng() % 40000));
+        }
+    }
+    std::vector<const Set*> pointers;
+    for(const auto& set: sets){
+        pointers.push_back(&set);
+    }
+
+    for(std::size_t count: {0, 1, 2, 3, 40}){
+        auto united = combine_all(pointers.data(), count, false);
+        auto intersected = combine_all(pointers.data(), count, true);
+        Set expected_union, expected_intersection;
+        if(count > 0){
+            expected_union = sets[0];
+            expected_intersection = sets[0];
+        }
+        for(std::size_t index = 1; index < count; ++index){
+            expected_union = expected_union | sets[index];
+            expected_intersection = expected_intersection & sets[index];
+        }
+        assert(std::equal(united.begin(), united.end(), expected_union.begin(), expected_union.end()));
+        assert(std::equal(intersected.begin(), intersected.end(), expected_intersection.begin(), expected_intersection.end()));
+    }
+}
+
+void test_bitvector_kernels(){
+    using detail::bitvector_kernels::simd;
+    auto& active = detail::bitvector_kernels::active_simd();
+    const auto detected = active;
+
+    std::mt19937 rng{0};
+    int16_set_bitvector lhs, rhs;
+    std::set<uint16_t> lhs_reference, rhs_reference;
+    for(int i = 0; i < 20000; ++i){
+        auto a = static_cast<uint16_t>(rng());
+        auto b = static_cast<uint16_t>(rng());
+        lhs.insert(a);
+        rhs.insert(b);
+        lhs_reference.insert(a);
+        rhs_reference.insert(b);
+    }
+
+    // Every variant which this CPU can run has to give the same results
+    for(auto level: {simd::scalar, simd::avx2, simd::avx512}){
+        if(level > detected){
+            continue;
+        }
+        active = level;
+
+        assert(lhs.size() == lhs_reference.size());
+        assert(rhs.size() == rhs_reference.size());
+
+        auto intersection = lhs & rhs;
+        auto union_ = lhs | rhs;
+        auto difference = lhs - rhs;
+        auto symmetric_difference = lhs ^ rhs;
+        auto in_place = lhs;
+        in_place &= rhs;
+        in_place |= difference;
+        in_place ^= rhs;
+        in_place -= rhs;
+
+        for(uint32_t value = 0; value < 65536; ++value){
+            auto in_lhs = lhs_reference.count(value) == 1;
+            auto in_rhs = rhs_reference.count(value) == 1;
+            assert(intersection.contains(value) == (in_lhs && in_rhs));
+            assert(union_.contains(value) == (in_lhs || in_rhs));
+            assert(difference.contains(value) == (in_lhs && !in_rhs));
+            assert(symmetric_difference.contains(value) == (in_lhs != in_rhs));
+            // ((lhs & rhs) | (lhs - rhs)) == lhs, then ^ rhs and - rhs leave lhs - rhs
+            assert(in_place.contains(value) == (in_lhs && !in_rhs));
+        }
+
+        assert(lhs.intersection_count(rhs) == intersection.size());
+        assert(lhs.union_count(rhs) == union_.size());
+        assert(lhs.difference_count(rhs) == difference.size());
+    }
+
+    active = detected;
+}
+
+void test_trie(){
+    // Counts kept in nodes have to follow every operation, rank of each value is checked against a running count
+    auto check_counts = [](const int16_set_trie& set){
+        std::size_t rank = 0;
+        for(uint32_t value = 0; value < 65536; ++value){
+            rank += set.contains(value);
+            assert(set.rank(value) == rank);
+        }
+        assert(set.size() == rank);
+    };
+
+    std::mt19937 rng{1};
+    std::set<uint16_t> reference, reference2;
+    int16_set_trie trie, trie2;
+    for(int i = 0; i < 5000; ++i){
+        auto value = static_cast<uint16_t>(rng());
+        trie.insert(value);
+        reference.insert(value);
+        auto value2 = static_cast<uint16_t>(rng() % 4096);
+        trie2.insert(value2);
+        reference2.insert(value2);
+    }
+
+    // Copies share nothing with the original
+    auto copy = trie;
+    copy.insert(static_cast<uint16_t>(*reference.begin() + 1));
+
+    auto united = trie | trie2;
+    for(uint32_t value = 0; value < 65536; ++value){
+        assert(trie.contains(value) == (reference.count(value) == 1));
+        assert(trie2.contains(value) == (reference2.count(value) == 1));
+        assert(united.contains(value) == (reference.count(value) || reference2.count(value)));
+    }
+    assert(copy.contains(*reference.begin() + 1));
+
+    auto intersected = trie & trie2;
+    auto in_place_union = trie;
+    in_place_union |= trie2;
+    auto in_place_intersection = trie;
+    in_place_intersection &= trie2;
+    for(uint32_t value = 0; value < 65536; ++value){
+        bool in_both = reference.count(value) && reference2.count(value);
+        assert(intersected.contains(value) == in_both);
+        assert(in_place_intersection.contains(value) == in_both);
+        assert(in_place_union.contains(value) == united.contains(value));
+    }
+    for(auto set: {&trie, &trie2, &united, &intersected, &in_place_union, &in_place_intersection}){
+        check_counts(*set);
+    }
+
+    // Erasing everything prunes the trie back to the root, so inserting again reuses pruned nodes
+    auto erased = trie;
+    for(auto value: reference){
+        erased.erase(value);
+        erased.erase(value);
+    }
+    for(uint32_t value = 0; value < 65536; ++value){
+        assert(!erased.contains(value));
+    }
+    check_counts(erased);
+    for(auto value: reference2){
+        erased.insert(value);
+    }
+    erased &= int16_set_trie{};
+    for(auto value: reference){
+        erased.insert(value);
+    }
+    for(uint32_t value = 0; value < 65536; ++value){
+        assert(erased.contains(value) == (reference.count(value) == 1));
+    }
+    check_counts(erased);
+
+    // Sorted input with repeats is counted per leaf
+    std::vector<uint16_t> sorted(reference.begin(), reference.end());
+    sorted.insert(sorted.end(), reference2.begin(), reference2.end());
+    std::sort(sorted.begin(), sorted.end());
+    erased.insert_many(sorted.data(), sorted.size());
+    check_counts(erased);
+    assert(erased.size() == united.size());
+}
+
 int main() {
     test<int16_set_bitvector>();
     test<int16_set_trie>();
+    test<int16_set_hybrid>();
+    test_hybrid();
+    test_rank();
+    test_trie();
+    test_order_statistics<int16_set_bitvector>();
+    test_order_statistics<int16_set_trie>();
+    test_many<int16_set_bitvector>();
+    test_many<int16_set_trie>();
+    test_serialization<int16_set_bitvector>();
+    test_serialization<int16_set_trie>();
+    for(std::size_t threads: {1, 3, 64}){
+        test_combine_all<int16_set_bitvector>([threads](auto sets, std::size_t count, bool intersection){
+            return intersection ? int16_set_bitvector::intersect_all(sets, count, threads)
+                                : int16_set_bitvector::union_all(sets, count, threads);
+        });
+    }
+    test_combine_all<int16_set_trie>([](auto sets, std::size_t count, bool intersection){
+        return intersection ? int16_set_trie::intersect_all(sets, count) : int16_set_trie::union_all(sets, count);
+    });
+    test_bitvector_kernels();
+    test_wide<int32_set, uint32_t>();
+    test_wide<int64_set, uint64_t>();
     return 0;
 }
@@ -0,0 +1,148 @@
+#ifndef HW4_WIDE_INT_SET_HH
+#define HW4_WIDE_INT_SET_HH
+
+#include "int16_set_hybrid.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/// Set of 32-bit or 64-bit values split by their upper bits into a sorted directory
+/// of int16 sets holding the lowest 16 bits, i.e. a Roaring bitmap
+template<typename ValueType>
+class wide_int_set {
+    static_assert(std::is_unsigned_v<ValueType> && sizeof(ValueType) > sizeof(uint16_t),
+                  "wide_int_set needs unsigned type wider than 16 bits");
+public:
+    void insert(ValueType value){
+        auto found = find_bucket(high(value));
+        if(found == m_buckets.end() || found->high != high(value)){
+            found = m_buckets.insert(found, bucket{high(value), {}});
+        }
+        found->low.insert(low(value));
+    }
+
+    void erase(ValueType value){
+        auto found = find_bucket(high(value));
+        if(found == m_buckets.end() || found->high != high(value)){
+            return;
+        }
+        found->low.erase(low(value));
+        if(found->low.size() == 0){
+            m_buckets.erase(found);
+        }
+    }
+
+    bool contains(ValueType value) const {
+        auto found = find_bucket(high(value));
+        return found != m_buckets.end() && found->high == high(value) && found->low.contains(low(value));
+    }
+
+    std::size_t size() const {
+        std::size_t result = 0;
+        for(const auto& b: m_buckets){
+            result += b.low.size();
+        }
+        return result;
+    }
+
+    /// Number of values in set less than or equal to value
+    std::size_t rank(ValueType value) const {
+        std::size_t result = 0;
+        for(const auto& b: m_buckets){
+            if(b.high > high(value)){
+                break;
+            }
+            result += b.high == high(value) ? b.low.rank(low(value)) : b.low.size();
+        }
+        return result;
+    }
+
+    /// Switches every int16 set to its smallest representation
+    void optimize(){
+        for(auto& b: m_buckets){
+            b.low.optimize();
+        }
+    }
+
+    wide_int_set operator|(const wide_int_set& rhs) const {
+        wide_int_set result;
+        result.m_buckets.reserve(m_buckets.size() + rhs.m_buckets.size());
+        auto lhs_it = m_buckets.begin();
+        auto rhs_it = rhs.m_buckets.begin();
+        while(lhs_it != m_buckets.end() && rhs_it != rhs.m_buckets.end()){
+            if(lhs_it->high < rhs_it->high){
+                result.m_buckets.push_back(*lhs_it++);
+            }
+            else if(rhs_it->high < lhs_it->high){
+                result.m_buckets.push_back(*rhs_it++);
+            }
+            else{
+                result.m_buckets.push_back(bucket{lhs_it->high, lhs_it->low | rhs_it->low});
+                ++lhs_it;
+                ++rhs_it;
+            }
+        }
+        result.m_buckets.insert(result.m_buckets.end(), lhs_it, m_buckets.end());
+        result.m_buckets.insert(result.m_buckets.end(), rhs_it, rhs.m_buckets.end());
+        return result;
+    }
+
+    wide_int_set operator&(const wide_int_set& rhs) const {
+        wide_int_set result;
+        auto lhs_it = m_buckets.begin();
+        auto rhs_it = rhs.m_buckets.begin();
+        while(lhs_it != m_buckets.end() && rhs_it != rhs.m_buckets.end()){
+            if(lhs_it->high < rhs_it->high){
+                ++lhs_it;
+            }
+            else if(rhs_it->high < lhs_it->high){
+                ++rhs_it;
+            }
+            else{
+                auto low = lhs_it->low & rhs_it->low;
+                if(low.size() != 0){
+                    result.m_buckets.push_back(bucket{lhs_it->high, std::move(low)});
+                }
+                ++lhs_it;
+                ++rhs_it;
+            }
+        }
+        return result;
+    }
+
+private:
+    struct bucket {
+        ValueType high;
+        int16_set_hybrid low;
+    };
+
+    /// Sorted by high, no bucket is empty
+    std::vector<bucket> m_buckets;
+
+    static ValueType high(ValueType value){
+        return value >> 16;
+    }
+
+    static uint16_t low(ValueType value){
+        return static_cast<uint16_t>(value);
+    }
+
+    auto find_bucket(ValueType high) const {
+        return std::lower_bound(m_buckets.begin(), m_buckets.end(), high, [](const bucket& lhs, ValueType rhs){
+            return lhs.high < rhs;
+        });
+    }
+
+    auto find_bucket(ValueType high){
+        return std::lower_bound(m_buckets.begin(), m_buckets.end(), high, [](const bucket& lhs, ValueType rhs){
+            return lhs.high < rhs;
+        });
+    }
+};
+
+using int32_set = wide_int_set<uint32_t>;
+using int64_set = wide_int_set<uint64_t>;
+
+#endif //HW4_WIDE_INT_SET_HH